@@ -0,0 +1,44 @@
+#pragma once
+
+#include "asciinema/pipeline.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace asciinema {
+
+struct BenchConfig {
+    PipelineConfig pipeline;        // output, size, paced and max_frames are set by run_bench
+    Dimensions size{160, 45};       // character grid, independent of any terminal
+    size_t decode_queue_size = 16;
+    size_t render_queue_size = 8;
+    uint64_t frames = 600;
+    bool paced = false;             // unpaced measures capacity, paced measures playback
+    std::string video_path;         // empty: synthetic source
+    int source_width = 1280;
+    int source_height = 720;
+    double source_fps = 30.0;
+    size_t source_clip_frames = 0;  // synthetic clip length before it loops; zero never ends
+    size_t source_hold_frames = 1;  // frames each synthetic picture stays up
+    bool source_copy = false;       // copy synthetic pictures into per-frame images, as a decoder would
+    bool curses = false;            // time ncurses drawing of synthetic frames instead of the pipeline
+    bool ascii_kernel = false;      // time the fused ASCII kernel against cv::resize + cv::cvtColor instead
+};
+
+// Runs the whole pipeline headless into the null output until config.frames
+// have been rendered, then writes one line of JSON with per-stage throughput,
+// latency percentiles and output bytes. Returns a process exit code.
+//
+// With config.curses, instead draws config.frames synthetic ASCII frames
+// through ncurses into a scratch file, once erasing and adding a character
+// at a time and once a row at a time over the previous frame, and reports
+// CPU time and output bytes per frame for each.
+//
+// With config.ascii_kernel, instead turns config.frames synthetic frames
+// into ASCII glyphs twice, with FrameProcessor's fused kernel and with
+// cv::resize, cv::cvtColor and a ramp lookup, reports CPU time per frame for
+// each and whether every glyph matched. Fails if any did not.
+int run_bench(const BenchConfig& config, std::ostream& out);
+
+}
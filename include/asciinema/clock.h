@@ -0,0 +1,55 @@
+#pragma once
+
+#include "asciinema/types.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace asciinema {
+
+// Maps media timestamps onto the monotonic clock. The render stage anchors it
+// when it presents the first frame; every stage reads it to decide whether a
+// frame can still make its slot.
+class PlaybackClock {
+public:
+    void anchor(TimePoint at, Duration pts) {
+        origin_.store((at.time_since_epoch() - pts).count(), std::memory_order_relaxed);
+        started_.store(true, std::memory_order_release);
+    }
+
+    void reset() { started_.store(false, std::memory_order_release); }
+
+    // Frames later than this past their due time are not worth showing.
+    void set_tolerance(Duration tolerance) { tolerance_ = tolerance; }
+
+    [[nodiscard]] bool started() const { return started_.load(std::memory_order_acquire); }
+
+    [[nodiscard]] TimePoint due(Duration pts) const {
+        Duration origin{origin_.load(std::memory_order_relaxed)};
+        return TimePoint(std::chrono::duration_cast<Clock::duration>(origin + pts));
+    }
+
+    [[nodiscard]] bool is_late(Duration pts, TimePoint at = now()) const {
+        return started() && at > due(pts) + tolerance_;
+    }
+
+    [[nodiscard]] bool is_early(Duration pts, TimePoint at = now()) const {
+        return !started() || at < due(pts);
+    }
+
+private:
+    std::atomic<Duration::rep> origin_{0};
+    std::atomic<bool> started_{false};
+    Duration tolerance_{0};
+};
+
+// sleep_until() overshoots by up to a scheduler tick; sleep coarsely, then
+// yield through the last stretch.
+inline void sleep_until_precise(TimePoint deadline) {
+    constexpr auto SPIN_WINDOW = std::chrono::microseconds(1500);
+    if (deadline - now() > SPIN_WINDOW) std::this_thread::sleep_until(deadline - SPIN_WINDOW);
+    while (now() < deadline) std::this_thread::yield();
+}
+
+}
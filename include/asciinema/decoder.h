@@ -1,6 +1,7 @@
 #pragma once
 
 #include "asciinema/frame.h"
+#include "asciinema/source.h"
 #include "asciinema/types.h"
 
 #include <opencv2/videoio.hpp>
@@ -9,10 +10,10 @@
 
 namespace asciinema {
 
-class VideoDecoder {
+class VideoDecoder : public FrameSource {
 public:
     VideoDecoder() = default;
-    ~VideoDecoder() = default;
+    ~VideoDecoder() override = default;
 
     VideoDecoder(const VideoDecoder&) = delete;
     VideoDecoder& operator=(const VideoDecoder&) = delete;
@@ -25,8 +26,19 @@ public:
 
     [[nodiscard]] std::optional<RawFrame> next_frame();
 
+    // Advances to the next frame with grab() only: the packet is demuxed and
+    // decoded but not converted to BGR, so a frame that is never retrieved
+    // costs little. Returns false at end of stream.
+    [[nodiscard]] bool grab() override;
+    // Presentation time of the grabbed frame, increasing across rewinds.
+    [[nodiscard]] Duration grabbed_pts() const override;
+    // Converts the grabbed frame.
+    [[nodiscard]] std::optional<RawFrame> retrieve() override;
+    [[nodiscard]] std::optional<RawFrame> retrieve_into(cv::Mat buffer) override;
+
     [[nodiscard]] double fps() const;
     [[nodiscard]] double frame_delay_ms() const;
+    [[nodiscard]] Duration frame_interval() const override;
     [[nodiscard]] int64_t total_frames() const;
     [[nodiscard]] int width() const;
     [[nodiscard]] int height() const;
@@ -34,11 +46,20 @@ public:
 
     void seek(int64_t frame_number);
     void reset();
+    // Seeks back to the start while keeping FrameIds and timestamps
+    // increasing, so a looped clip reads as one continuous stream.
+    void rewind() override;
+    [[nodiscard]] bool seek_frame(size_t index) override;
 
 private:
     cv::VideoCapture capture_;
     std::string path_;
     FrameId next_frame_id_ = 0;
+    FrameId grabbed_id_ = 0;
+    Duration grabbed_pts_{0};
+    Duration clip_pts_{0};
+    Duration pts_base_{0};
+    bool grabbed_in_clip_ = false;
     double fps_ = 0.0;
     int64_t total_frames_ = 0;
     int width_ = 0;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/types.h"
+
+#include <string>
+#include <vector>
+
+namespace asciinema {
+
+// A horizontal span of cells to repaint, zero-based.
+struct CellRun {
+    int row;
+    int col;
+    int length;
+};
+
+// Remembers the cell grid currently on screen and works out which runs of
+// cells a new frame changes. Unchanged gaps shorter than a cursor move are
+// folded into the surrounding run.
+class DeltaTracker {
+public:
+    // Fills runs with the cells that differ from what is on screen. Returns
+    // false when a full repaint is cheaper or required (first frame, resize,
+    // render mode change).
+    [[nodiscard]] bool diff(const ProcessedFrame& frame, std::vector<CellRun>& runs);
+
+    // Records frame as presented. Swaps cell storage with the frame, so the
+    // frame is left holding the previous grid for recycling.
+    void present(ProcessedFrame& frame);
+
+    // Forgets the screen contents; the next frame is drawn in full.
+    void invalidate();
+
+    [[nodiscard]] size_t changed_cells() const { return changed_cells_; }
+
+private:
+    CellGrid screen_;
+    bool valid_ = false;
+    size_t changed_cells_ = 0;
+};
+
+// The encoders append to out, sizing it for the worst case first.
+
+// Encodes runs of a color mode as cursor moves plus SGRs: RGB backgrounds
+// for TrueColor, 48;5;n for Palette256, 40-47/100-107 for Palette16, and
+// for HalfBlock upper-half blocks with RGB foreground and background, set
+// only where they change. Ends with an SGR reset.
+void encode_color_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out);
+
+// Encodes ASCII runs as cursor moves plus their glyphs.
+void encode_ascii_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out);
+
+// Encodes a whole grid from the cursor's position, one newline-terminated
+// row per grid row. Color rows set the background wherever it changes and
+// end with an SGR reset.
+void encode_grid(const CellGrid& cells, std::string& out);
+
+// The number of bytes encode_grid appends, counted without encoding.
+[[nodiscard]] size_t encoded_grid_size(const CellGrid& cells);
+
+}
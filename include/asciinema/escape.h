@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace asciinema {
+
+// Raw-cursor helpers for building terminal escape sequences without streams.
+// Callers size the destination for the worst case up front.
+namespace escape {
+
+    // Pre-rendered decimal text for every channel value, padded to four bytes so
+    // a writer can copy a fixed-width chunk and advance by the real length.
+    struct DecimalTable {
+        char text[256][4];
+        uint8_t length[256];
+
+        constexpr DecimalTable() : text{}, length{} {
+            for (int v = 0; v < 256; ++v) {
+                int n = 0;
+                if (v >= 100) text[v][n++] = static_cast<char>('0' + v / 100);
+                if (v >= 10) text[v][n++] = static_cast<char>('0' + v / 10 % 10);
+                text[v][n++] = static_cast<char>('0' + v % 10);
+                length[v] = static_cast<uint8_t>(n);
+            }
+        }
+    };
+
+    inline constexpr DecimalTable DECIMALS;
+
+    inline constexpr char SGR_BG[] = "\033[48;2;";
+    inline constexpr char SGR_FG[] = "\033[38;2;";
+    inline constexpr char SGR_AND_BG[] = ";48;2;";
+    inline constexpr char SGR_BG_256[] = "\033[48;5;";
+    inline constexpr char SGR_RESET[] = "\033[0m";
+    inline constexpr size_t SGR_BG_LEN = sizeof(SGR_BG) - 1;
+    inline constexpr size_t SGR_BG_256_LEN = sizeof(SGR_BG_256) - 1;
+    inline constexpr size_t SGR_FG_LEN = sizeof(SGR_FG) - 1;
+    inline constexpr size_t SGR_AND_BG_LEN = sizeof(SGR_AND_BG) - 1;
+    inline constexpr size_t SGR_RESET_LEN = sizeof(SGR_RESET) - 1;
+
+    // Longest background SGR: prefix, three values with separators, 'm'.
+    // The palette forms are shorter.
+    inline constexpr size_t SGR_BG_MAX = SGR_BG_LEN + 3 * 4 + 1;
+    // Longest combined foreground and background SGR.
+    inline constexpr size_t SGR_FG_BG_MAX = SGR_FG_LEN + 11 + SGR_AND_BG_LEN + 11 + 1;
+
+    // U+2580 UPPER HALF BLOCK in UTF-8.
+    inline constexpr char UPPER_HALF[] = "\xe2\x96\x80";
+    inline constexpr size_t UPPER_HALF_LEN = sizeof(UPPER_HALF) - 1;
+    // Longest cursor move: ESC [ row ; col H with five-digit coordinates.
+    inline constexpr size_t CURSOR_MOVE_MAX = 2 + 5 + 1 + 5 + 1;
+
+    inline char* put(char* out, const char* text, size_t len) {
+        std::memcpy(out, text, len);
+        return out + len;
+    }
+
+    inline char* put_decimal(char* out, uint8_t value) {
+        std::memcpy(out, DECIMALS.text[value], 4);
+        return out + DECIMALS.length[value];
+    }
+
+    inline char* put_uint(char* out, unsigned value) {
+        char digits[10];
+        int n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (n) *out++ = digits[--n];
+        return out;
+    }
+
+    // R;G;B of a packed 0x00RRGGBB color.
+    inline char* put_rgb(char* out, uint32_t rgb) {
+        out = put_decimal(out, static_cast<uint8_t>(rgb >> 16));
+        *out++ = ';';
+        out = put_decimal(out, static_cast<uint8_t>(rgb >> 8));
+        *out++ = ';';
+        return put_decimal(out, static_cast<uint8_t>(rgb));
+    }
+
+    inline size_t rgb_length(uint32_t rgb) {
+        return DECIMALS.length[(rgb >> 16) & 0xff] + DECIMALS.length[(rgb >> 8) & 0xff] +
+               DECIMALS.length[rgb & 0xff] + 2;
+    }
+
+    inline char* put_bg(char* out, uint8_t r, uint8_t g, uint8_t b) {
+        out = put(out, SGR_BG, SGR_BG_LEN);
+        out = put_decimal(out, r);
+        *out++ = ';';
+        out = put_decimal(out, g);
+        *out++ = ';';
+        out = put_decimal(out, b);
+        *out++ = 'm';
+        return out;
+    }
+
+    inline char* put_fg(char* out, uint32_t rgb) {
+        out = put(out, SGR_FG, SGR_FG_LEN);
+        out = put_rgb(out, rgb);
+        *out++ = 'm';
+        return out;
+    }
+
+    // Both colors in one SGR.
+    inline char* put_fg_bg(char* out, uint32_t fg, uint32_t bg) {
+        out = put(out, SGR_FG, SGR_FG_LEN);
+        out = put_rgb(out, fg);
+        out = put(out, SGR_AND_BG, SGR_AND_BG_LEN);
+        out = put_rgb(out, bg);
+        *out++ = 'm';
+        return out;
+    }
+
+    // Background from the 256-color palette.
+    inline char* put_bg_256(char* out, uint8_t index) {
+        out = put(out, SGR_BG_256, SGR_BG_256_LEN);
+        out = put_decimal(out, index);
+        *out++ = 'm';
+        return out;
+    }
+
+    // Background from the 16 basic colors, as 40-47 or, bright, 100-107.
+    inline char* put_bg_16(char* out, uint8_t index) {
+        *out++ = '\033';
+        *out++ = '[';
+        if (index >= 8) {
+            *out++ = '1';
+            *out++ = '0';
+        } else {
+            *out++ = '4';
+        }
+        *out++ = static_cast<char>('0' + (index & 7));
+        *out++ = 'm';
+        return out;
+    }
+
+    // Moves the cursor to a zero-based cell.
+    inline char* put_cursor(char* out, int row, int col) {
+        *out++ = '\033';
+        *out++ = '[';
+        out = put_uint(out, static_cast<unsigned>(row + 1));
+        *out++ = ';';
+        out = put_uint(out, static_cast<unsigned>(col + 1));
+        *out++ = 'H';
+        return out;
+    }
+
+}  
+
+}  
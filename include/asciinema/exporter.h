@@ -0,0 +1,53 @@
+#pragma once
+
+#include "asciinema/pipeline.h"
+#include "asciinema/types.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace asciinema {
+
+struct ExporterConfig {
+    std::string socket_path;  // serve Prometheus text on this Unix domain socket
+    std::string json_path;    // append one JSON line per interval to this file
+    Duration interval = std::chrono::seconds(1);
+};
+
+// Samples a running pipeline's Metrics and queue depths on its own thread,
+// so monitoring never touches the render path. Each interval it rebuilds the
+// Prometheus text exposition it serves to socket clients (answered as
+// HTTP/1.0, so `curl --unix-socket` works) and optionally appends a JSON line.
+class MetricsExporter {
+public:
+    explicit MetricsExporter(const Pipeline& pipeline) : pipeline_(pipeline) {}
+    ~MetricsExporter() { stop(); }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    [[nodiscard]] bool start(const ExporterConfig& config);
+    void stop();
+
+private:
+    void run();
+    void sample();
+    void serve(int client) const;
+    [[nodiscard]] std::string prometheus_text() const;
+    [[nodiscard]] std::string json_line() const;
+    void close_all();
+
+    const Pipeline& pipeline_;
+    ExporterConfig config_;
+    int listen_fd_ = -1;
+    int wake_fds_[2] = {-1, -1};
+    std::FILE* json_ = nullptr;
+    std::string exposition_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+}
@@ -3,22 +3,43 @@
 #include "asciinema/types.h"
 
 #include <opencv2/core/mat.hpp>
-#include <string>
+#include <algorithm>
+#include <cstring>
 #include <utility>
+#include <vector>
 
 namespace asciinema {
 
+// When a frame crossed each stage boundary. Consecutive differences give
+// the per-stage breakdown of its decode-to-written latency.
+struct StageTimes {
+    TimePoint grabbed{};           // decode stage started on it
+    TimePoint decoded{};           // retrieved, about to be handed off
+    TimePoint process_dequeued{};
+    TimePoint processed{};
+    TimePoint render_dequeued{};
+    TimePoint draw_start{};        // due; pacing wait over
+    TimePoint written{};
+    uint32_t worker = 0;           // process worker that handled it
+};
+
 struct RawFrame {
     FrameId id;
     TimePoint timestamp;
+    Duration pts;  // presentation time on the media timeline
     cv::Mat image;
+    StageTimes stages;
+    uint32_t clip_index = 0;  // position in a looping clip
+    bool cached = false;      // no image: the process stage copies it from the loop cache
+    bool repeat = false;      // no image: shows the same picture as frame repeat_of
+    FrameId repeat_of = 0;
 
-    RawFrame() : id(0), timestamp{}, image{} {}
+    RawFrame() : id(0), timestamp{}, pts{0}, image{} {}
 
-    RawFrame(FrameId frame_id, TimePoint ts, cv::Mat img)
-        : id(frame_id), timestamp(ts), image(std::move(img)) {}
+    RawFrame(FrameId frame_id, TimePoint ts, cv::Mat img, Duration media_pts = Duration{0})
+        : id(frame_id), timestamp(ts), pts(media_pts), image(std::move(img)) {}
 
-    [[nodiscard]] bool valid() const { return !image.empty(); }
+    [[nodiscard]] bool valid() const { return !image.empty() || cached || repeat; }
 
     RawFrame(RawFrame&&) = default;
     RawFrame& operator=(RawFrame&&) = default;
@@ -26,18 +47,138 @@ struct RawFrame {
     RawFrame& operator=(const RawFrame&) = default;
 };
 
+// Values are stored in frame files, so new modes go at the end.
+enum class RenderMode { ASCII, TrueColor, Palette256, Palette16, HalfBlock };
+
+// Modes that draw colored cells through escape sequences rather than
+// glyphs through ncurses.
+inline bool is_color(RenderMode mode) { return mode != RenderMode::ASCII; }
+
+// Picture rows each character row shows: HalfBlock draws an upper-half
+// block in the top pixel's color over the bottom pixel's.
+inline int rows_per_cell(RenderMode mode) { return mode == RenderMode::HalfBlock ? 2 : 1; }
+
+// Packs a color as 0x00RRGGBB.
+inline uint32_t pack_rgb(uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+}
+
+// What each cell of a frame shows, row-major, as parallel arrays. A mode
+// only fills the arrays it draws with: ASCII the glyphs on the terminal's
+// own colors, the color modes the background colors of blank cells, and
+// HalfBlock the top (fg) and bottom (bg) pixel colors. Turning cells into
+// bytes for a terminal is left to the render stage.
+struct CellGrid {
+    Dimensions dims{0, 0};
+    RenderMode mode = RenderMode::ASCII;
+    std::vector<uint8_t> glyph;
+    std::vector<uint32_t> fg;  // packed 0x00RRGGBB, or a palette index in the palette modes
+    std::vector<uint32_t> bg;
+
+    // Sizes the arrays mode draws with to the area of dims and empties the
+    // others, keeping their storage. Returns true when that had to allocate.
+    bool reset(Dimensions size, RenderMode render_mode) {
+        const size_t before = capacity();
+        const size_t area = static_cast<size_t>(std::max(size.area(), 0));
+        dims = size;
+        mode = render_mode;
+        glyph.resize(render_mode == RenderMode::ASCII ? area : 0);
+        fg.resize(render_mode == RenderMode::HalfBlock ? area : 0);
+        bg.resize(is_color(render_mode) ? area : 0);
+        return capacity() != before;
+    }
+
+    [[nodiscard]] size_t area() const { return static_cast<size_t>(std::max(dims.area(), 0)); }
+    [[nodiscard]] bool empty() const { return glyph.empty() && fg.empty() && bg.empty(); }
+
+    // Bytes of storage held, used or not.
+    [[nodiscard]] size_t capacity() const {
+        return glyph.capacity() + (fg.capacity() + bg.capacity()) * sizeof(uint32_t);
+    }
+
+    void swap(CellGrid& other) {
+        std::swap(dims, other.dims);
+        std::swap(mode, other.mode);
+        glyph.swap(other.glyph);
+        fg.swap(other.fg);
+        bg.swap(other.bg);
+    }
+};
+
+// Cells packed for storage: the glyph byte in ASCII mode, R, G, B in
+// TrueColor mode, the palette index in the palette modes and the top then
+// the bottom R, G, B in HalfBlock mode.
+inline size_t cell_bytes(RenderMode mode) {
+    switch (mode) {
+        case RenderMode::TrueColor: return 3;
+        case RenderMode::HalfBlock: return 6;
+        default:                    return 1;
+    }
+}
+
+// Packs cells [first, first + count) of grid.
+inline uint8_t* store_cells(const CellGrid& grid, size_t first, size_t count, uint8_t* out) {
+    if (grid.mode == RenderMode::ASCII) {
+        std::memcpy(out, grid.glyph.data() + first, count);
+        return out + count;
+    }
+    const uint32_t* bg = grid.bg.data() + first;
+    if (grid.mode == RenderMode::Palette256 || grid.mode == RenderMode::Palette16) {
+        for (size_t i = 0; i < count; ++i) *out++ = static_cast<uint8_t>(bg[i]);
+        return out;
+    }
+    const uint32_t* fg = grid.mode == RenderMode::HalfBlock ? grid.fg.data() + first : nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        if (fg) {
+            *out++ = static_cast<uint8_t>(fg[i] >> 16);
+            *out++ = static_cast<uint8_t>(fg[i] >> 8);
+            *out++ = static_cast<uint8_t>(fg[i]);
+        }
+        *out++ = static_cast<uint8_t>(bg[i] >> 16);
+        *out++ = static_cast<uint8_t>(bg[i] >> 8);
+        *out++ = static_cast<uint8_t>(bg[i]);
+    }
+    return out;
+}
+
+// Unpacks count cells into grid from first on; grid is already sized.
+inline const uint8_t* load_cells(const uint8_t* in, size_t first, size_t count, CellGrid& grid) {
+    if (grid.mode == RenderMode::ASCII) {
+        std::memcpy(grid.glyph.data() + first, in, count);
+        return in + count;
+    }
+    uint32_t* bg = grid.bg.data() + first;
+    if (grid.mode == RenderMode::Palette256 || grid.mode == RenderMode::Palette16) {
+        for (size_t i = 0; i < count; ++i) bg[i] = *in++;
+        return in;
+    }
+    uint32_t* fg = grid.mode == RenderMode::HalfBlock ? grid.fg.data() + first : nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        if (fg) {
+            fg[i] = pack_rgb(in[0], in[1], in[2]);
+            in += 3;
+        }
+        bg[i] = pack_rgb(in[0], in[1], in[2]);
+        in += 3;
+    }
+    return in;
+}
+
 struct ProcessedFrame {
     FrameId id;
     TimePoint timestamp;
-    std::string char_grid;
-    Dimensions dimensions;
-
-    ProcessedFrame() : id(0), timestamp{}, char_grid{}, dimensions{0, 0} {}
+    Duration pts;
+    CellGrid cells;
+    StageTimes stages;
+    uint32_t clip_index = 0;
+    // No cells: the screen already shows frame repeat_of, so rendering
+    // writes nothing.
+    bool repeat = false;
+    FrameId repeat_of = 0;
 
-    ProcessedFrame(FrameId frame_id, TimePoint ts, std::string grid, Dimensions dims)
-        : id(frame_id), timestamp(ts), char_grid(std::move(grid)), dimensions(dims) {}
+    ProcessedFrame() : id(0), timestamp{}, pts{0} {}
 
-    [[nodiscard]] bool valid() const { return !char_grid.empty(); }
+    [[nodiscard]] bool valid() const { return !cells.empty() || repeat; }
     [[nodiscard]] Duration latency() const { return now() - timestamp; }
     [[nodiscard]] double latency_ms() const { return to_ms(latency()); }
 
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "asciinema/delta.h"
+#include "asciinema/frame.h"
+#include "asciinema/source.h"
+#include "asciinema/types.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace asciinema {
+
+// Processed output stored for replay without decoding or processing. Layout,
+// in host byte order:
+//
+//   FrameFileHeader
+//   payloads     one per frame, back to back
+//   index        FrameFileIndexEntry[frame_count] at index_offset
+//
+// A payload is a u32 run count followed by runs of { u32 first cell,
+// u32 length, length cells }. A cell is stored as cell_bytes() of its mode
+// lays it out: a glyph, R, G, B, a palette index, or two R, G, Bs for half
+// blocks. Key frames hold one run over the whole grid; the rest only hold
+// cells that changed since the previous frame.
+struct FrameFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t mode;
+    uint32_t cols;
+    uint32_t rows;
+    int64_t frame_interval_ns;
+    uint64_t frame_count;
+    uint64_t index_offset;
+    uint64_t reserved[2];
+};
+
+struct FrameFileIndexEntry {
+    int64_t pts_ns;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t flags;
+};
+
+static_assert(sizeof(FrameFileHeader) == 64, "frame file header layout");
+static_assert(sizeof(FrameFileIndexEntry) == 24, "frame file index layout");
+
+inline constexpr uint32_t FRAME_FILE_KEY = 1;
+
+// Appends processed frames to a frame file, delta coding each against the
+// one before it.
+class FrameFileWriter {
+public:
+    FrameFileWriter() = default;
+    ~FrameFileWriter() { close(); }
+
+    FrameFileWriter(const FrameFileWriter&) = delete;
+    FrameFileWriter& operator=(const FrameFileWriter&) = delete;
+
+    [[nodiscard]] bool open(const std::string& path, Dimensions dims, RenderMode mode, Duration frame_interval);
+    [[nodiscard]] bool is_open() const { return file_ != nullptr; }
+
+    // Frames must match the file's size and mode. Takes the frame's cells
+    // like DeltaTracker::present, leaving it holding the previous grid.
+    [[nodiscard]] bool append(ProcessedFrame& frame);
+
+    // Writes the index and completes the header. Returns false if any
+    // write failed along the way.
+    bool close();
+
+    [[nodiscard]] uint64_t frames() const { return index_.size(); }
+    [[nodiscard]] uint64_t bytes() const { return offset_; }
+
+private:
+    bool write(const void* data, size_t size);
+
+    std::FILE* file_ = nullptr;
+    FrameFileHeader header_{};
+    DeltaTracker screen_;
+    std::vector<CellRun> runs_;
+    std::string payload_;
+    std::vector<FrameFileIndexEntry> index_;
+    uint64_t offset_ = 0;
+    bool failed_ = false;
+};
+
+// Replays a frame file through mmap: each frame costs applying its runs
+// and copying out the cell grid, with no OpenCV work at all.
+class FrameFileReader {
+public:
+    FrameFileReader() = default;
+    ~FrameFileReader() { close(); }
+
+    FrameFileReader(const FrameFileReader&) = delete;
+    FrameFileReader& operator=(const FrameFileReader&) = delete;
+
+    // True when path starts with the frame file magic.
+    [[nodiscard]] static bool is_frame_file(const std::string& path);
+
+    [[nodiscard]] bool open(const std::string& path);
+    [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+    void close();
+
+    [[nodiscard]] Dimensions dimensions() const { return dims_; }
+    [[nodiscard]] RenderMode mode() const { return mode_; }
+    [[nodiscard]] Duration frame_interval() const { return Duration(header_.frame_interval_ns); }
+    [[nodiscard]] uint64_t frame_count() const { return header_.frame_count; }
+
+    // Decodes the next frame into frame, reusing its storage. Returns false
+    // at the end of the file.
+    [[nodiscard]] bool next(ProcessedFrame& frame);
+
+    // Starts over from the first frame while keeping FrameIds and pts
+    // increasing, as FrameSource::rewind does.
+    void rewind();
+
+    // Number of times an output frame had to be allocated or grown.
+    [[nodiscard]] uint64_t allocations() const { return allocations_; }
+
+private:
+    void apply(const uint8_t* payload, size_t size);
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    FrameFileHeader header_{};
+    const uint8_t* index_ = nullptr;  // may be unaligned; entries are read with memcpy
+    Dimensions dims_{0, 0};
+    RenderMode mode_ = RenderMode::ASCII;
+
+    CellGrid cells_;
+    size_t next_ = 0;
+    FrameId next_id_ = 0;
+    Duration clip_pts_{0};
+    Duration pts_base_{0};
+    uint64_t allocations_ = 0;
+};
+
+// Processes every frame of source once, until it reports end of stream, and
+// writes the result to path. Returns the number of frames written, or zero
+// on failure.
+[[nodiscard]] uint64_t transcode(FrameSource& source, const std::string& path, Dimensions dims,
+                                 RenderMode mode, int color_tolerance, bool dither = false);
+
+}
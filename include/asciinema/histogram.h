@@ -0,0 +1,155 @@
+#pragma once
+
+#include "asciinema/queue.h"
+#include "asciinema/types.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace asciinema {
+
+// Fixed-bucket, log-linear (HDR-style) layout over nanoseconds: values below
+// 32 ns get a bucket each, every power of two above is split into 32 linear
+// sub-buckets. Any value reads back within ~3%, up to 2^36 ns (~68 s).
+struct HistogramLayout {
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB = uint64_t{1} << SUB_BITS;
+    static constexpr int MAX_BITS = 36;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB;
+
+    static constexpr size_t index(uint64_t ns) {
+        if (ns < SUB) return static_cast<size_t>(ns);
+        int msb = 63 - __builtin_clzll(ns);
+        if (msb >= MAX_BITS) return BUCKETS - 1;
+        int shift = msb - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB + (ns >> shift) - SUB);
+    }
+
+    // Midpoint of the bucket's range.
+    static constexpr uint64_t value(size_t index) {
+        if (index < SUB) return index;
+        int shift = static_cast<int>(index / SUB) - 1;
+        uint64_t lower = (index % SUB + SUB) << shift;
+        return lower + ((uint64_t{1} << shift) >> 1);
+    }
+};
+
+// Merged, immutable copy of a Histogram. All results are in milliseconds.
+class HistogramSnapshot {
+public:
+    [[nodiscard]] uint64_t count() const { return count_; }
+    [[nodiscard]] double max() const { return to_ms(Duration(max_ns_)); }
+    [[nodiscard]] double sum() const { return to_ms(Duration(sum_ns_)); }
+    [[nodiscard]] double avg() const {
+        return count_ ? to_ms(Duration(sum_ns_)) / static_cast<double>(count_) : 0.0;
+    }
+
+    [[nodiscard]] double percentile(double p) const {
+        if (count_ == 0) return 0.0;
+        auto rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(count_) + 0.5);
+        rank = std::max<uint64_t>(std::min(rank, count_), 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank)
+                return to_ms(Duration(std::min(HistogramLayout::value(i), max_ns_)));
+        }
+        return max();
+    }
+
+    [[nodiscard]] double p50() const { return percentile(50.0); }
+    [[nodiscard]] double p95() const { return percentile(95.0); }
+    [[nodiscard]] double p99() const { return percentile(99.0); }
+    [[nodiscard]] double p999() const { return percentile(99.9); }
+
+    // Samples recorded after earlier was taken, for windowed percentiles.
+    // max() stays the all-time maximum.
+    [[nodiscard]] HistogramSnapshot since(const HistogramSnapshot& earlier) const {
+        HistogramSnapshot window = *this;
+        for (size_t i = 0; i < counts_.size(); ++i)
+            window.counts_[i] -= std::min(earlier.counts_[i], counts_[i]);
+        window.count_ -= std::min(earlier.count_, count_);
+        window.sum_ns_ -= std::min(earlier.sum_ns_, sum_ns_);
+        return window;
+    }
+
+    [[nodiscard]] std::string to_json() const {
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+            "{\"count\":%llu,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f,\"avg\":%.3f}",
+            static_cast<unsigned long long>(count_), p50(), p95(), p99(), p999(), max(), avg());
+        return buf;
+    }
+
+private:
+    friend class Histogram;
+
+    std::array<uint64_t, HistogramLayout::BUCKETS> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ns_ = 0;
+    uint64_t max_ns_ = 0;
+};
+
+// Lock-free duration histogram, cumulative since construction. Each writer
+// records into its own cache-aligned shard with relaxed atomic adds, so
+// writers never contend; snapshot() merges the shards for readers. A
+// histogram fed by one stage thread needs one writer; the process stage's
+// get one per worker, passing the worker index.
+class Histogram {
+public:
+    explicit Histogram(size_t writers = 1) { set_writers(writers); }
+
+    // Gives writers 0 to writers - 1 a shard each and clears the samples.
+    // Not safe while other threads record or take snapshots.
+    void set_writers(size_t writers) {
+        writers_ = std::max<size_t>(writers, 1);
+        shards_ = std::make_unique<Shard[]>(writers_);
+    }
+    [[nodiscard]] size_t writers() const { return writers_; }
+
+    void record(Duration d, size_t writer = 0) {
+        uint64_t ns = d.count() > 0 ? static_cast<uint64_t>(d.count()) : 0;
+        Shard& shard = shards_[writer < writers_ ? writer : writer % writers_];
+
+        shard.counts[HistogramLayout::index(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (ns > max && !shard.max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+
+    void record(double ms, size_t writer = 0) { record(from_ms(ms), writer); }
+
+    [[nodiscard]] HistogramSnapshot snapshot() const {
+        HistogramSnapshot merged;
+        for (size_t w = 0; w < writers_; ++w) {
+            const Shard& shard = shards_[w];
+            for (size_t i = 0; i < HistogramLayout::BUCKETS; ++i) {
+                uint64_t n = shard.counts[i].load(std::memory_order_relaxed);
+                merged.counts_[i] += n;
+                merged.count_ += n;
+            }
+            merged.sum_ns_ += shard.sum.load(std::memory_order_relaxed);
+            merged.max_ns_ = std::max(merged.max_ns_, shard.max.load(std::memory_order_relaxed));
+        }
+        return merged;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::array<std::atomic<uint64_t>, HistogramLayout::BUCKETS> counts{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    size_t writers_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+}
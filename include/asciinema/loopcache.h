@@ -0,0 +1,80 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/types.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace asciinema {
+
+// Processed frames of a looping clip, keyed by position in the clip, so
+// later passes skip decode and process. Cells are packed into one arena at
+// a fixed stride, and frames are only appended in clip order: with a
+// memory budget smaller than the clip, the cache holds a prefix. Everything
+// below size() is immutable, so readers need no lock.
+class LoopCache {
+public:
+    // Sizes the arena for as many frames as fit in budget_bytes. A zero
+    // budget disables the cache.
+    void reset(Dimensions dims, RenderMode mode, size_t budget_bytes);
+
+    [[nodiscard]] bool enabled() const { return capacity_ > 0; }
+    [[nodiscard]] size_t capacity() const { return capacity_; }
+    [[nodiscard]] size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    // Single writer. Stores frame when it is the next clip position the
+    // cache is missing; returns whether it did. A repeat stores another
+    // copy of the previous position.
+    bool insert(const ProcessedFrame& frame);
+
+    // Fills frame from the cached position of raw, reusing its storage.
+    // raw.clip_index must be below size().
+    void load(const RawFrame& raw, ProcessedFrame& frame) const;
+
+private:
+    std::unique_ptr<uint8_t[]> arena_;
+    Dimensions dims_{0, 0};
+    RenderMode mode_ = RenderMode::ASCII;
+    size_t frame_bytes_ = 0;
+    size_t capacity_ = 0;
+    std::atomic<size_t> size_{0};
+};
+
+// Decode thread only. Records each frame's pts offset on the first pass
+// through a clip, then numbers positions and pts for every later pass
+// itself, so frames served from the cache and frames read from the source
+// line up whichever way the source was positioned.
+class LoopTimeline {
+public:
+    explicit LoopTimeline(Duration frame_interval) : interval_(frame_interval) {}
+
+    // True once the source has reached its end once.
+    [[nodiscard]] bool learned() const { return length_ > 0; }
+    [[nodiscard]] uint32_t index() const { return index_; }
+
+    // pts of the current position. On the first pass, records the source's
+    // pts and passes it through.
+    [[nodiscard]] Duration pts(Duration source_pts);
+    // Later passes only: a source that runs longer than it did on the first
+    // pass wraps at the learned length.
+    [[nodiscard]] Duration pts() const;
+
+    // Moves to the next position, wrapping to a new pass at the clip length.
+    void advance();
+    // The source ran out at the current position.
+    void end_of_clip();
+
+private:
+    void next_pass();
+
+    std::vector<Duration> offsets_;  // from the first frame of the clip
+    Duration interval_;
+    Duration origin_{0};             // pts of the current pass's first frame
+    uint32_t index_ = 0;
+    uint32_t length_ = 0;
+};
+
+}
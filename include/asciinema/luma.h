@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace asciinema {
+
+// One sample of cv::resize's INTER_LINEAR: two source columns (as byte
+// offsets into a row) or two source rows, and their weights out of 2048.
+// A column's second pixel is the one after its first, or has no weight.
+struct LinearTap {
+    int first;
+    int second;
+    int weight[2];
+};
+
+// One output row of cv::resize's INTER_LINEAR on an 8-bit gray, BGR or BGRA
+// image followed by cv::COLOR_BGR2GRAY: each of the width samples blends
+// columns[x] of the top and bottom source rows across, then the two rows
+// down with weights beta0 and beta1. All variants round as OpenCV does and
+// produce identical bytes.
+using LumaRowFn = void (*)(const uint8_t* top, const uint8_t* bottom, int row_bytes, int channels,
+                           const LinearTap* columns, int width, int beta0, int beta1, uint8_t* luma);
+
+void linear_luma_scalar(const uint8_t* top, const uint8_t* bottom, int row_bytes, int channels,
+                        const LinearTap* columns, int width, int beta0, int beta1, uint8_t* luma);
+
+// Picks the widest kernel the CPU supports (SSE4.1, scalar).
+[[nodiscard]] LumaRowFn select_luma_kernel();
+[[nodiscard]] const char* luma_kernel_name(LumaRowFn kernel);
+// Every kernel the CPU can run, widest first.
+[[nodiscard]] std::vector<LumaRowFn> supported_luma_kernels();
+
+}
@@ -1,73 +1,60 @@
 #pragma once
 
-#include <algorithm>
+#include "asciinema/histogram.h"
+#include "asciinema/types.h"
+
+#include <array>
 #include <atomic>
 #include <chrono>
-#include <deque>
-#include <mutex>
+#include <cstdint>
+#include <cstdio>
 #include <string>
 
 namespace asciinema {
 
+// Frames per second over roughly the last second, without locks: ticks land
+// in 125 ms slots tagged with their epoch, and readers sum the live ones.
+// Expects one ticking thread at a time.
 class FPSCounter {
 public:
     void tick() {
-        auto now = std::chrono::steady_clock::now();
-        std::lock_guard<std::mutex> lock(mutex_);
-        timestamps_.push_back(now);
-        
-        auto cutoff = now - std::chrono::seconds(1);
-        while (!timestamps_.empty() && timestamps_.front() < cutoff)
-            timestamps_.pop_front();
+        int64_t epoch = epoch_of(now());
+        Slot& slot = slots_[epoch % SLOTS];
+        if (slot.epoch.load(std::memory_order_relaxed) != epoch) {
+            slot.count.store(0, std::memory_order_relaxed);
+            slot.epoch.store(epoch, std::memory_order_release);
+        }
+        slot.count.fetch_add(1, std::memory_order_relaxed);
     }
 
     double fps() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return static_cast<double>(timestamps_.size());
+        TimePoint at = now();
+        int64_t epoch = epoch_of(at);
+        uint64_t ticks = 0;
+        for (const Slot& slot : slots_) {
+            int64_t tagged = slot.epoch.load(std::memory_order_acquire);
+            if (tagged <= epoch && tagged + SLOTS > epoch)
+                ticks += slot.count.load(std::memory_order_relaxed);
+        }
+        // The current slot is only partly elapsed.
+        Duration window = SLOT * (SLOTS - 1) + (at.time_since_epoch() - SLOT * epoch);
+        return static_cast<double>(ticks) / (to_ms(window) / 1000.0);
     }
 
 private:
-    mutable std::mutex mutex_;
-    std::deque<std::chrono::steady_clock::time_point> timestamps_;
-};
+    static constexpr Duration SLOT = std::chrono::milliseconds(125);
+    static constexpr int64_t SLOTS = 8;
 
-class LatencyTracker {
-public:
-    explicit LatencyTracker(size_t window = 100) : window_(window) {}
-
-    void record(double ms) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        samples_.push_back(ms);
-        if (samples_.size() > window_)
-            samples_.pop_front();
-    }
+    struct Slot {
+        std::atomic<int64_t> epoch{-1};
+        std::atomic<uint64_t> count{0};
+    };
 
-    double p50() const { return percentile(50); }
-    double p95() const { return percentile(95); }
-    double avg() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (samples_.empty()) return 0;
-        double sum = 0;
-        for (double s : samples_) sum += s;
-        return sum / samples_.size();
+    static int64_t epoch_of(TimePoint at) {
+        return at.time_since_epoch() / SLOT;
     }
 
-private:
-    double percentile(int p) const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (samples_.empty()) return 0;
-        
-        std::vector<double> sorted(samples_.begin(), samples_.end());
-        std::sort(sorted.begin(), sorted.end());
-        
-        size_t idx = (p * sorted.size()) / 100;
-        if (idx >= sorted.size()) idx = sorted.size() - 1;
-        return sorted[idx];
-    }
-
-    mutable std::mutex mutex_;
-    std::deque<double> samples_;
-    size_t window_;
+    std::array<Slot, SLOTS> slots_{};
 };
 
 struct Metrics {
@@ -75,24 +62,82 @@ struct Metrics {
     FPSCounter process_fps;
     FPSCounter render_fps;
     
-    LatencyTracker latency{100};
+    Histogram latency;       // decoded to written
+    Histogram jitter;        // |presented - scheduled|
+
+    // Per-stage service times: grab + retrieve, process(), diff + encode + write
+    Histogram decode_time;
+    Histogram process_time;
+    Histogram draw_time;
+
+    // Time between stages. For a presented frame, process_wait + process_time
+    // + render_wait + pace_wait + draw_time adds up to its latency.
+    Histogram process_wait;  // decoded -> dequeued by a worker
+    Histogram render_wait;   // processed -> dequeued by render (reorder + queue)
+    Histogram pace_wait;     // dequeued by render -> due
+
+    Histogram tty_write_time;  // write() calls per flush of a frame to the terminal
     
     std::atomic<uint64_t> frames_decoded{0};
+    std::atomic<uint64_t> frames_skipped{0};
     std::atomic<uint64_t> frames_processed{0};
     std::atomic<uint64_t> frames_rendered{0};
     std::atomic<uint64_t> frames_dropped{0};
+    std::atomic<uint64_t> frames_repeated{0};  // rendered as a repeat of the picture on screen
+    std::atomic<uint64_t> grid_allocations{0};
+    std::atomic<uint64_t> bytes_rendered{0};
+    std::atomic<uint64_t> quality_level{0};    // rung of the adaptive quality ladder, 0 = full
+    std::atomic<uint64_t> quality_changes{0};
+    std::atomic<uint64_t> loop_cache_hits{0};     // frames served from the loop cache
+    std::atomic<uint64_t> loop_cache_misses{0};   // frames decoded while the cache was on
+    std::atomic<uint64_t> loop_cache_frames{0};   // clip positions cached so far
+    std::atomic<uint64_t> tty_frames{0};   // frames handed to the terminal writer
+    std::atomic<uint64_t> tty_writes{0};   // write() calls they took
+    std::atomic<uint64_t> tty_stalls{0};   // writes refused with EAGAIN
+    std::atomic<uint64_t> tty_unsent{0};   // frames discarded while the previous one drained
+    std::atomic<uint64_t> image_pool_hits{0};         // frames decoded into a pooled image
+    std::atomic<uint64_t> image_pool_misses{0};       // frames the source allocated an image for
+    std::atomic<uint64_t> image_pool_outstanding{0};  // pooled images some frame still holds
+
+    // A shard per process worker in the histograms the workers record into.
+    // Call before the stage threads start.
+    void set_process_workers(size_t workers) {
+        process_time.set_writers(workers);
+        process_wait.set_writers(workers);
+    }
+
+    double writes_per_frame() const {
+        uint64_t frames = tty_frames.load();
+        return frames ? static_cast<double>(tty_writes.load()) / frames : 0.0;
+    }
+
+    double bytes_per_frame() const {
+        uint64_t frames = frames_rendered.load();
+        return frames ? static_cast<double>(bytes_rendered.load()) / frames : 0.0;
+    }
 
+    // Percentiles are cumulative since start; each call merges the shards,
+    // so callers should not format more often than they display.
     std::string format() const {
-        char buf[256];
+        HistogramSnapshot lat = latency.snapshot();
+        char buf[320];
         snprintf(buf, sizeof(buf),
-            "FPS D:%.0f P:%.0f R:%.0f | Lat %.1f/%.1fms | Drop %llu | Frames %llu",
+            "FPS D:%.0f P:%.0f R:%.0f | Lat %.1f/%.1f/%.1fms | Jit %.2fms | Svc %.2f/%.2f/%.2fms | Drop %llu | Skip %llu | Frames %llu | %.1fKB/f | Alloc %llu",
             decode_fps.fps(),
             process_fps.fps(),
             render_fps.fps(),
-            latency.p50(),
-            latency.p95(),
-            frames_dropped.load(),
-            frames_rendered.load()
+            lat.p50(),
+            lat.p95(),
+            lat.p99(),
+            jitter.snapshot().p95(),
+            decode_time.snapshot().p95(),
+            process_time.snapshot().p95(),
+            draw_time.snapshot().p95(),
+            static_cast<unsigned long long>(frames_dropped.load()),
+            static_cast<unsigned long long>(frames_skipped.load()),
+            static_cast<unsigned long long>(frames_rendered.load()),
+            bytes_per_frame() / 1024.0,
+            static_cast<unsigned long long>(grid_allocations.load())
         );
         return buf;
     }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "asciinema/frame.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asciinema {
+
+// Nearest entry of a terminal palette for every color, with channels cut to
+// five bits: a 32x32x32 table, so mapping a pixel is one load.
+struct PaletteLut {
+    static constexpr int BITS = 5;
+    static constexpr size_t SIZE = size_t{1} << (3 * BITS);
+
+    uint8_t index[SIZE];
+
+    [[nodiscard]] uint8_t lookup(uint8_t r, uint8_t g, uint8_t b) const {
+        return index[(r >> 3) << (2 * BITS) | (g >> 3) << BITS | b >> 3];
+    }
+};
+
+// Table for Palette256 or Palette16, built on first use. The 256-color
+// table only maps to entries 16-255, whose colors are fixed; terminals
+// theme the basic 16, which Palette16 uses as xterm defines them.
+[[nodiscard]] const PaletteLut& palette_lut(RenderMode mode);
+
+// Ordered dithering: a 4x4 Bayer offset for each cell position, about a
+// palette step wide, added to every channel before the lookup.
+struct DitherMatrix {
+    int8_t offset[4][4];
+
+    constexpr explicit DitherMatrix(int spread) : offset{} {
+        constexpr int BAYER[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+        for (int y = 0; y < 4; ++y)
+            for (int x = 0; x < 4; ++x) offset[y][x] = static_cast<int8_t>((2 * BAYER[y][x] + 1 - 16) * spread / 32);
+    }
+};
+
+// Palette256 levels are 40 apart; Palette16 has only off, half and full.
+inline constexpr DitherMatrix DITHER_256{40};
+inline constexpr DitherMatrix DITHER_16{112};
+
+}
@@ -1,23 +1,71 @@
 #pragma once
 
+#include "asciinema/clock.h"
 #include "asciinema/decoder.h"
+#include "asciinema/delta.h"
 #include "asciinema/frame.h"
+#include "asciinema/framefile.h"
+#include "asciinema/loopcache.h"
 #include "asciinema/metrics.h"
+#include "asciinema/pool.h"
 #include "asciinema/processor.h"
+#include "asciinema/quality.h"
 #include "asciinema/queue.h"
 #include "asciinema/renderer.h"
+#include "asciinema/reorder.h"
+#include "asciinema/source.h"
+#include "asciinema/still.h"
+#include "asciinema/taskpool.h"
+#include "asciinema/trace.h"
+#include "asciinema/tty.h"
 
 #include <atomic>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace asciinema {
 
+// What a stage does when the next queue is full. Frames that are not yet due
+// always wait for room; the policy applies once playback is behind.
+enum class OverflowPolicy {
+    DropNewest,    // try_push: discard the frame being handed off
+    Backpressure,  // push: block until the consumer catches up, never drop late frames
+    DropOldest     // push_latest: evict the stalest queued frame
+};
+
+// Where the render stage sends frames. Null still diffs and encodes every
+// frame and counts its bytes, but writes nothing and leaves the tty alone.
+enum class OutputTarget {
+    Terminal,
+    Null
+};
+
+// Upper bound on process_workers; the CLIs reject anything above it.
+inline constexpr size_t MAX_PROCESS_WORKERS = 64;
+
 struct PipelineConfig {
     RenderMode mode = RenderMode::ASCII;
-    bool backpressure = false;
+    OverflowPolicy overflow = OverflowPolicy::DropNewest;
+    int color_tolerance = 0;
+    bool dither = false;         // ordered dithering in the palette modes
+    size_t process_workers = 1;
+    size_t band_threads = 0;     // extra threads splitting each large frame into row bands; zero disables
+    size_t reorder_window = 16;  // frames buffered for reordering before late ones are dropped
+    OutputTarget output = OutputTarget::Terminal;
+    Dimensions size{0, 0};       // character grid; zero fits the terminal
+    bool paced = true;           // false presents frames as soon as they arrive
+    uint64_t max_frames = 0;     // stop after rendering this many; zero loops forever
+    std::string trace_path;      // Chrome trace-event JSON of per-frame stage spans
+    Duration latency_slo{0};     // adapt quality to hold decode-to-written p95 under this; zero keeps it fixed
+    size_t loop_cache_bytes = 0; // keep processed frames of a looping clip within this budget; zero disables
+    int static_threshold = -1;   // frames within this per-row mean difference of the last processed one repeat it; negative disables
 };
 
+// Character grid that fits the terminal, leaving room for the stats line.
+[[nodiscard]] Dimensions terminal_size();
+
 class Pipeline {
 public:
     Pipeline(size_t decode_queue_size = 16, size_t render_queue_size = 8);
@@ -26,35 +74,84 @@ public:
     Pipeline(const Pipeline&) = delete;
     Pipeline& operator=(const Pipeline&) = delete;
 
+    // Frame files are replayed; anything else is opened as a video.
     bool start(const std::string& video_path, const PipelineConfig& config);
+    bool start(std::unique_ptr<FrameSource> source, const PipelineConfig& config);
+    // Replays precomputed frames straight into the render queue. The file
+    // fixes the grid size and render mode; quality adaptation is off.
+    bool start(std::unique_ptr<FrameFileReader> file, const PipelineConfig& config);
     void stop();
     bool is_running() const { return running_; }
 
     const Metrics& metrics() const { return metrics_; }
-    size_t decode_queue_depth() const { return decode_queue_.size(); }
+    size_t decode_queue_depth() const;
+    size_t decode_queue_capacity() const;
     size_t render_queue_depth() const { return render_queue_.size(); }
+    size_t render_queue_capacity() const { return render_queue_.capacity(); }
 
 private:
+    // One process stage thread with its own input queue and scratch buffers.
+    // The decoder deals frames round-robin; the render stage returns spent
+    // frames round-robin for reuse.
+    struct ProcessWorker {
+        ProcessWorker(size_t input_size, size_t spare_size) : input(input_size), spares(spare_size) {}
+
+        SpscQueue<RawFrame> input;
+        SpscQueue<ProcessedFrame> spares;
+        FrameProcessor processor;
+        std::thread thread;
+    };
+
+    bool launch(const PipelineConfig& config, Duration frame_interval);
     void decode_loop();
-    void process_loop();
+    void process_loop(size_t index);
+    void replay_loop();
+    uint32_t align_source(uint32_t index, uint32_t at);
     void render_loop();
+    void release_frame(ProcessedFrame&& frame);
+    void recycle_frame(ProcessedFrame&& frame);
+    void adapt_quality();
+
+    template <typename T>
+    bool hand_off(SpscQueue<T>& queue, T item);
+    [[nodiscard]] bool is_early(Duration pts) const { return paced_ && clock_.is_early(pts); }
 
     std::atomic<bool> running_{false};
     RenderMode mode_{RenderMode::ASCII};
-    bool backpressure_{false};
+    OverflowPolicy overflow_{OverflowPolicy::DropNewest};
+    OutputTarget output_{OutputTarget::Terminal};
+    bool paced_ = true;
+    uint64_t max_frames_ = 0;
 
-    VideoDecoder decoder_;
-    FrameProcessor processor_;
+    std::unique_ptr<FrameSource> source_;
+    std::unique_ptr<FrameFileReader> replay_;  // stands in for decode and a single process worker
+    PlaybackClock clock_;
     Dimensions dims_;
+    Duration read_ahead_{0};
+
+    // Written by the render thread, applied by each worker before its next frame.
+    QualityController quality_;
+    std::atomic<size_t> quality_level_{0};
+
+    // Filled by the render thread in clip order; read by the workers.
+    LoopCache loop_cache_;
+
+    // Decode thread only, except enabled(), which is fixed while running.
+    StillDetector still_;
 
-    BoundedQueue<RawFrame> decode_queue_;
-    BoundedQueue<ProcessedFrame> render_queue_;
+    size_t decode_queue_size_;
+    std::unique_ptr<TaskPool> bands_;  // shared by the workers' processors
+    std::vector<std::unique_ptr<ProcessWorker>> workers_;
+    ReorderBuffer reorder_;
+    SpscQueue<ProcessedFrame> render_queue_;
 
     std::thread decode_thread_;
-    std::thread process_thread_;
     std::thread render_thread_;
+    size_t recycle_worker_ = 0;
 
     Metrics metrics_;
+    ImagePool image_pool_{metrics_};  // decode thread only
+    TraceWriter trace_;
 };
 
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "asciinema/metrics.h"
+
+#include <opencv2/core/mat.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace asciinema {
+
+// Decode thread only. Images for the source to convert frames into, so a
+// steady stream of frames allocates nothing.
+//
+// The pool keeps a reference to every image it owns, and an image is free
+// again once that is the only one left: nothing is handed back explicitly.
+// Whichever thread drops a frame last (a worker once it is processed, the
+// decode thread when it is skipped or repeats, a queue evicting it) returns
+// its image with the reference count it already updates, and an image the
+// still detector holds on to is never overwritten.
+class ImagePool {
+public:
+    explicit ImagePool(Metrics& metrics) : metrics_(metrics) {}
+
+    // Owns at most capacity images; zero turns pooling off.
+    void reset(size_t capacity);
+
+    [[nodiscard]] bool enabled() const { return capacity_ > 0; }
+
+    // A free image to decode into, or an empty one when none is free.
+    [[nodiscard]] cv::Mat acquire();
+
+    // Accounts for the image a frame was decoded into: a hit when it is the
+    // one acquire() lent, a miss when the source had to allocate it, in
+    // which case the pool adopts it while it has room. Images the source
+    // shares from its own storage are neither.
+    void record(const cv::Mat& image);
+
+private:
+    Metrics& metrics_;
+    std::vector<cv::Mat> images_;
+    size_t capacity_ = 0;
+    size_t next_ = 0;        // where the search for a free image starts
+    const uint8_t* lent_ = nullptr;
+};
+
+}
@@ -1,14 +1,16 @@
 #pragma once
 
 #include "asciinema/frame.h"
+#include "asciinema/luma.h"
+#include "asciinema/palette.h"
+#include "asciinema/taskpool.h"
 #include "asciinema/types.h"
 
 #include <opencv2/core/mat.hpp>
+#include <vector>
 
 namespace asciinema {
 
-enum class RenderMode { ASCII, TrueColor };
-
 class FrameProcessor {
 public:
     explicit FrameProcessor(Dimensions dims = {80, 24}, RenderMode mode = RenderMode::ASCII);
@@ -19,13 +21,78 @@ public:
     void set_render_mode(RenderMode mode);
     [[nodiscard]] RenderMode render_mode() const;
 
+    // Neighbouring TrueColor cells within this distance share one color run.
+    // 0 (the default) only merges identical colors.
+    void set_color_tolerance(int tolerance);
+    [[nodiscard]] int color_tolerance() const;
+
+    // Ordered dithering in the palette modes: smoother gradients, but
+    // shorter color runs and more changed cells. Off by default.
+    void set_dithering(bool dither);
+    [[nodiscard]] bool dithering() const;
+
+    // Samples one cell per scale x scale block and repeats it, keeping the
+    // grid size: fewer samples, longer color runs, less output. 1 is full detail.
+    void set_cell_scale(int scale);
+    [[nodiscard]] int cell_scale() const;
+
+    // Splits large frames into row bands that run on pool, which may be
+    // shared with other processors and must outlive this one. Null (the
+    // default) processes every frame on the calling thread.
+    void set_band_pool(TaskPool* pool) { bands_ = pool; }
+
     [[nodiscard]] ProcessedFrame process(const RawFrame& frame);
 
+    // Hands a rendered frame back so later frames reuse its storage.
+    void recycle(ProcessedFrame&& frame);
+
+    // An output frame sized for the current settings, reusing recycled
+    // storage when there is some.
+    [[nodiscard]] ProcessedFrame spare_frame();
+
+    // Number of times an output frame had to be allocated or grown.
+    [[nodiscard]] uint64_t allocations() const;
+
 private:
+    // Encodes sampled rows [sy0, sy1) of a frame into cells, with band
+    // picking the scratch to use.
+    using EncodeFn = void (FrameProcessor::*)(const cv::Mat& image, int sy0, int sy1, size_t band, CellGrid& cells);
+
+    // Picks the kernel for the current mode, tolerance and cell scale and
+    // images with this many channels.
+    void select_kernel(int channels);
+    template <int Channels>
+    [[nodiscard]] EncodeFn kernel_for() const;
+
+    template <int Channels, bool Exact, bool Scaled, bool Halves>
+    void encode_truecolor(const cv::Mat& image, int sy0, int sy1, size_t band, CellGrid& cells);
+    template <int Channels, bool Dither, bool Scaled>
+    void encode_palette(const cv::Mat& image, int sy0, int sy1, size_t band, CellGrid& cells);
+    template <int Channels, bool Scaled>
+    void encode_ascii(const cv::Mat& image, int sy0, int sy1, size_t band, CellGrid& cells);
+
+    void update_linear_taps(int width, int height);
+    [[nodiscard]] size_t band_count(int sampled_rows) const;
+
     Dimensions dims_;
     RenderMode mode_;
+    int color_tolerance_ = 0;
+    int cell_scale_ = 1;
+    bool dither_ = false;
+    EncodeFn encode_ = nullptr;
+    const PaletteLut* palette_ = nullptr;  // of the current palette mode
+    int kernel_channels_ = 3;
+    LumaRowFn linear_luma_;
     cv::Mat resized_;
-    cv::Mat grayscale_;
+
+    std::vector<LinearTap> column_taps_;  // per ASCII sample column
+    std::vector<LinearTap> row_taps_;     // per ASCII sample row
+    int taps_width_ = 0;
+    int taps_height_ = 0;
+    std::vector<std::vector<uint8_t>> luma_rows_;  // one per band
+    TaskPool* bands_ = nullptr;
+    std::vector<ProcessedFrame> spare_;
+    uint64_t allocations_ = 0;
 };
 
 }  
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/histogram.h"
+#include "asciinema/metrics.h"
+#include "asciinema/types.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace asciinema {
+
+// One rung of the quality ladder, applied by every process worker.
+struct QualityLevel {
+    RenderMode mode;
+    int cell_scale;
+    int color_tolerance;
+};
+
+// What the controller saw over its last window.
+struct QualitySignals {
+    double latency_p95_ms = 0.0;
+    double load = 0.0;         // busiest stage's p95 service time / frame interval
+    double queue_fill = 0.0;   // decode queue depth / capacity: backlog in front of the workers
+    uint64_t lost = 0;         // frames dropped or skipped
+};
+
+// Feedback controller that trades picture quality for keeping up. Every
+// window it checks frame loss, the busiest stage's service time against the
+// frame budget, latency against the SLO and the backlog in front of the
+// workers. After sustained pressure it moves one rung down the ladder
+// (wider color runs, coarser cells, a palette, then ASCII); after a
+// longer stretch of headroom it moves back up.
+//
+// The latency and backlog signals assume decode read-ahead is capped below
+// the SLO (the pipeline does this when an SLO is set); otherwise queues sit
+// full by design and latency mostly measures buffering.
+class QualityController {
+public:
+    // Builds the ladder below top_mode. A zero slo disables the controller.
+    void reset(RenderMode top_mode, int color_tolerance, Duration slo);
+    [[nodiscard]] bool enabled() const { return slo_ > Duration::zero(); }
+
+    // Samples metrics since the previous call. Returns true when the level changed.
+    bool update(const Metrics& metrics, size_t workers, Duration frame_interval, double queue_fill);
+
+    [[nodiscard]] size_t level_index() const { return level_; }
+    [[nodiscard]] size_t levels() const { return ladder_.size(); }
+    [[nodiscard]] const QualityLevel& level(size_t index) const { return ladder_[index]; }
+    [[nodiscard]] const QualitySignals& signals() const { return signals_; }
+
+private:
+    bool step(const QualitySignals& signals);
+
+    std::vector<QualityLevel> ladder_;
+    Duration slo_{0};
+    size_t level_ = 0;
+    int behind_windows_ = 0;
+    int headroom_windows_ = 0;
+
+    QualitySignals signals_;
+    HistogramSnapshot latency_;
+    HistogramSnapshot decode_;
+    HistogramSnapshot process_;
+    HistogramSnapshot draw_;
+    uint64_t lost_ = 0;
+};
+
+}
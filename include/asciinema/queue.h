@@ -1,81 +1,210 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <thread>
+#include <vector>
 
 namespace asciinema {
 
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Fixed-capacity single-producer/single-consumer ring. push() blocks while
+// full and pop() while empty; after stop() neither blocks, and pop() returns
+// T{} only once the ring is drained. Hand-offs are a pair of atomic stores on
+// separate cache lines; a waiting side spins briefly, then parks on a
+// condition variable that the other side only touches when it knows someone
+// is asleep.
+// The head index is claimed with a CAS so the producer may also evict the
+// oldest item (push_latest). Capacity is rounded up to a power of two, and to
+// at least 2: with a single slot, a full slot's sequence (pos + 1) would equal
+// the empty sequence of the next lap, and a second push would overwrite it.
 template <typename T>
-class BoundedQueue {
+class SpscQueue {
 public:
-    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+    explicit SpscQueue(size_t capacity)
+        : capacity_(round_up_pow2(std::max<size_t>(capacity, 2))), mask_(capacity_ - 1), slots_(capacity_) {
+        for (size_t i = 0; i < capacity_; ++i)
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
 
     void push(T item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        not_full_.wait(lock, [this] { return queue_.size() < capacity_; });
-        queue_.push(std::move(item));
-        lock.unlock();
-        not_empty_.notify_one();
+        while (!enqueue(item)) {
+            if (stopped_.load(std::memory_order_acquire)) return;
+            park(producer_waiting_, not_full_, [this] { return writable(); });
+        }
     }
 
-    bool try_push(T item) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.size() >= capacity_) return false;
-        queue_.push(std::move(item));
-        not_empty_.notify_one();
-        return true;
-    }
+    bool try_push(T item) { return enqueue(item); }
 
     T pop() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        not_empty_.wait(lock, [this] { return !queue_.empty() || stopped_; });
-        if (stopped_ && queue_.empty()) return T{};
-        T item = std::move(queue_.front());
-        queue_.pop();
-        lock.unlock();
-        not_full_.notify_one();
-        return item;
+        for (;;) {
+            if (auto item = try_pop()) return std::move(*item);
+            if (stopped_.load(std::memory_order_acquire)) {
+                // An item pushed just before stop() may have landed after
+                // the failed try_pop above.
+                if (auto item = try_pop()) return std::move(*item);
+                return T{};
+            }
+            park(consumer_waiting_, not_empty_, [this] { return readable(); });
+        }
+    }
+
+    // Latest-wins push: never blocks and never rejects. When the ring is full
+    // the oldest queued item is evicted to make room. Returns how many were evicted.
+    size_t push_latest(T item) {
+        size_t evicted = 0;
+        while (!enqueue(item)) {
+            if (stopped_.load(std::memory_order_acquire)) break;
+            if (evict_oldest())
+                ++evicted;
+            else
+                cpu_relax();  // consumer is mid-pop on the slot we need
+        }
+        return evicted;
     }
 
     std::optional<T> try_pop() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) return std::nullopt;
-        T item = std::move(queue_.front());
-        queue_.pop();
-        not_full_.notify_one();
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        do {
+            slot = &slots_[pos & mask_];
+            if (slot->seq.load(std::memory_order_acquire) != pos + 1) return std::nullopt;
+        } while (!head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed));
+
+        std::optional<T> item(std::move(slot->value));
+        release(*slot, pos);
         return item;
     }
 
     void stop() {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            stopped_ = true;
-        }
+        stopped_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(park_mutex_);
         not_empty_.notify_all();
         not_full_.notify_all();
     }
 
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
     }
 
-    bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
-    }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() >= capacity_; }
 
     size_t capacity() const { return capacity_; }
 
 private:
-    std::queue<T> queue_;
-    mutable std::mutex mutex_;
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    static constexpr int SPIN_LIMIT = 128;
+    static constexpr int YIELD_LIMIT = 16;
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    bool enqueue(T& item) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[pos & mask_];
+        if (slot.seq.load(std::memory_order_acquire) != pos) return false;
+
+        slot.value = std::move(item);
+        slot.seq.store(pos + 1, std::memory_order_release);
+        tail_.store(pos + 1, std::memory_order_relaxed);
+        wake(consumer_waiting_, not_empty_);
+        return true;
+    }
+
+    // Only the oldest item can be evicted, and only if the consumer has not
+    // already claimed it; the producer then owns the slot it wants to write.
+    bool evict_oldest() {
+        size_t pos = tail_.load(std::memory_order_relaxed) - capacity_;
+        Slot& slot = slots_[pos & mask_];
+        if (slot.seq.load(std::memory_order_acquire) != pos + 1) return false;
+        if (!head_.compare_exchange_strong(pos, pos + 1, std::memory_order_relaxed)) return false;
+        release(slot, pos);
+        return true;
+    }
+
+    void release(Slot& slot, size_t pos) {
+        slot.value = T{};
+        slot.seq.store(pos + capacity_, std::memory_order_release);
+        wake(producer_waiting_, not_full_);
+    }
+
+    bool readable() const {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        return slots_[pos & mask_].seq.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    bool writable() const {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        return slots_[pos & mask_].seq.load(std::memory_order_acquire) == pos;
+    }
+
+    // The fence pairs with the one in park(): either the sleeper sees our
+    // slot update, or we see its waiting flag and take the lock to notify.
+    void wake(std::atomic<bool>& waiting, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!waiting.load(std::memory_order_relaxed)) return;
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        cv.notify_one();
+    }
+
+    template <typename Ready>
+    void park(std::atomic<bool>& waiting, std::condition_variable& cv, Ready ready) {
+        auto done = [&] { return ready() || stopped_.load(std::memory_order_acquire); };
+
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (done()) return;
+            cpu_relax();
+        }
+        for (int i = 0; i < YIELD_LIMIT; ++i) {
+            if (done()) return;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, done);
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::vector<Slot> slots_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> stopped_{false};
+    std::atomic<bool> consumer_waiting_{false};
+    std::atomic<bool> producer_waiting_{false};
+    std::mutex park_mutex_;
     std::condition_variable not_empty_;
     std::condition_variable not_full_;
-    size_t capacity_;
-    bool stopped_ = false;
 };
 
 }  
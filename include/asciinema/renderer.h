@@ -1,32 +1,48 @@
 #pragma once
 
+#include "asciinema/delta.h"
 #include "asciinema/frame.h"
 #include "asciinema/processor.h"
 
+#include <cstdio>
 #include <ncurses.h>
 #include <string>
 
 namespace asciinema {
 
+    // Draws ASCII frames through ncurses. Frames are written a row at a time
+    // over what the window already holds, never erased first, so ncurses
+    // only sends the cells that changed.
     class TerminalRenderer {
         public:
             TerminalRenderer();
+            // Draws into out instead of the terminal, at a fixed window size
+            // (grid plus the stats line), e.g. to benchmark the renderer.
+            TerminalRenderer(std::FILE* out, Dimensions grid);
             ~TerminalRenderer();
 
             TerminalRenderer(const TerminalRenderer&) = delete;
             TerminalRenderer& operator=(const TerminalRenderer&) = delete;
 
             [[nodiscard]] Dimensions dimensions() const;
+            [[nodiscard]] WINDOW* window() const { return win_; }
 
-            void render(const ProcessedFrame& frame, RenderMode mode);
+            // Whole grid, one mvaddnstr per row. A grid of a different size
+            // from the last one clears the window first.
+            void render(const ProcessedFrame& frame);
+            void render_runs(const ProcessedFrame& frame, const std::vector<CellRun>& runs);
             void render_stats(const std::string& stats);
             void clear();
             void refresh();
 
         private:
+            void put_row(int y, int x, const char* text, int length);
+
+            SCREEN* screen_ = nullptr;  // only when drawing into a stream
             WINDOW* win_;
             int rows_;
             int cols_;
+            Dimensions drawn_{0, 0};
     };
 
 } 
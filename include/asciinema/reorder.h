@@ -0,0 +1,147 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/types.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace asciinema {
+
+// Puts frames from several process workers back into FrameId order.
+// Each producer must insert its own frames in increasing id order; once every
+// producer has reached or passed an id that never arrived, it is given up on. Frames
+// further than the window ahead of the next expected id force the sequence
+// forward, and anything that arrives after its id was released is late.
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t producers = 1, size_t window = 16) { reset(producers, window); }
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    void reset(size_t producers, size_t window) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        producers = std::max<size_t>(producers, 1);
+        window_ = std::max<size_t>(window, 1);
+        slots_.assign(window_, ProcessedFrame{});
+        filled_.assign(window_, false);
+        last_seen_.assign(producers, NONE);
+        ready_.assign(producers, {});
+        next_ = 0;
+        tickets_ = 0;
+        served_ = 0;
+    }
+
+    // Calls release(ProcessedFrame&&) for every frame that is now in order.
+    // Releases run outside the buffer's lock, so a release that blocks does
+    // not hold up other producers' inserts, but they still run one producer
+    // at a time and in FrameId order. Returns the number of late frames
+    // discarded (0 or 1).
+    template <typename Release>
+    size_t insert(size_t producer, ProcessedFrame frame, Release&& release) {
+        size_t late = 0;
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const FrameId id = frame.id;
+            last_seen_[producer] = id;
+
+            if (id < next_) {
+                late = 1;
+            } else {
+                while (id >= next_ + window_) advance(producer);
+                size_t slot = id % window_;
+                slots_[slot] = std::move(frame);
+                filled_[slot] = true;
+            }
+            ticket = drain(producer);
+        }
+        deliver(producer, ticket, release);
+        return late;
+    }
+
+    // Tells the buffer a producer discarded id, so nothing waits on it.
+    template <typename Release>
+    void skip(size_t producer, FrameId id, Release&& release) {
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            last_seen_[producer] = id;
+            ticket = drain(producer);
+        }
+        deliver(producer, ticket, release);
+    }
+
+private:
+    static constexpr FrameId NONE = std::numeric_limits<FrameId>::max();
+
+    // Moves every frame that is now in order to the producer's ready list and
+    // takes a delivery ticket for it.
+    uint64_t drain(size_t producer) {
+        for (;;) {
+            if (filled_[next_ % window_])
+                advance(producer);
+            else if (settled(next_))
+                ++next_;  // every producer is at or past it; it was dropped
+            else
+                break;
+        }
+        return ready_[producer].empty() ? 0 : tickets_++;
+    }
+
+    void advance(size_t producer) {
+        size_t slot = next_ % window_;
+        if (filled_[slot]) {
+            filled_[slot] = false;
+            ready_[producer].push_back(std::move(slots_[slot]));
+        }
+        ++next_;
+    }
+
+    // Tickets are taken in drain order, so releasing strictly by ticket keeps
+    // batches from different producers in FrameId order.
+    template <typename Release>
+    void deliver(size_t producer, uint64_t ticket, Release& release) {
+        std::vector<ProcessedFrame>& ready = ready_[producer];
+        if (ready.empty()) return;
+        {
+            std::unique_lock<std::mutex> lock(turn_mutex_);
+            turn_.wait(lock, [&] { return served_ == ticket; });
+        }
+        for (ProcessedFrame& frame : ready) release(std::move(frame));
+        ready.clear();
+        {
+            std::lock_guard<std::mutex> lock(turn_mutex_);
+            ++served_;
+        }
+        turn_.notify_all();
+    }
+
+    // Producers hand over ids in increasing order, so once each one has
+    // reported id or a later one, an id still missing will never arrive.
+    bool settled(FrameId id) const {
+        for (FrameId seen : last_seen_)
+            if (seen == NONE || seen < id) return false;
+        return true;
+    }
+
+    std::mutex mutex_;
+    std::vector<ProcessedFrame> slots_;
+    std::vector<bool> filled_;
+    std::vector<FrameId> last_seen_;
+    std::vector<std::vector<ProcessedFrame>> ready_;  // per producer, touched outside mutex_ only by its owner
+    size_t window_ = 1;
+    FrameId next_ = 0;
+    uint64_t tickets_ = 0;
+
+    std::mutex turn_mutex_;
+    std::condition_variable turn_;
+    uint64_t served_ = 0;
+};
+
+}
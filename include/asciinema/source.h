@@ -0,0 +1,82 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/types.h"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+namespace asciinema {
+
+// Where the decode stage gets frames from. grab() advances cheaply so that
+// frames the pipeline sheds are never converted; retrieve() materialises
+// the grabbed one.
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // Returns false at end of stream.
+    [[nodiscard]] virtual bool grab() = 0;
+    // Presentation time of the grabbed frame, increasing across rewinds.
+    [[nodiscard]] virtual Duration grabbed_pts() const = 0;
+    [[nodiscard]] virtual std::optional<RawFrame> retrieve() = 0;
+    // Like retrieve(), converting into buffer's memory when it has the right
+    // size and type. The caller guarantees nothing else reads buffer. Sources
+    // that do not convert ignore it.
+    [[nodiscard]] virtual std::optional<RawFrame> retrieve_into(cv::Mat buffer) {
+        (void)buffer;
+        return retrieve();
+    }
+    [[nodiscard]] virtual Duration frame_interval() const = 0;
+    // Restarts the stream while keeping FrameIds and pts increasing.
+    virtual void rewind() = 0;
+    // Makes the next grab() return frame index of the clip. Sources that
+    // cannot seek return false.
+    [[nodiscard]] virtual bool seek_frame(size_t index) {
+        (void)index;
+        return false;
+    }
+};
+
+// Procedurally generated BGR frames for headless benchmarks: a scrolling
+// gradient with a moving box, so successive frames differ like video does.
+// A short loop is rendered up front and shared (cv::Mat is reference
+// counted), so the source costs next to nothing per frame unless it is
+// asked to copy.
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(int width, int height, double fps = 30.0, size_t loop_frames = 60);
+
+    // Ends the stream after this many frames, like a video file, until the
+    // next rewind(). Zero (the default) never ends.
+    void set_clip_frames(size_t frames) { clip_frames_ = frames; }
+    // Shows each picture for this many frames, like slides or a paused
+    // screencast. The default of one changes it every frame.
+    void set_hold_frames(size_t frames) { hold_frames_ = std::max<size_t>(frames, 1); }
+    // Copies every picture into an image of the frame's own, like a decoder
+    // converting into its output, so image buffers behave as with video.
+    void set_copy_frames(bool copy) { copy_frames_ = copy; }
+
+    [[nodiscard]] bool grab() override;
+    [[nodiscard]] Duration grabbed_pts() const override;
+    [[nodiscard]] std::optional<RawFrame> retrieve() override;
+    [[nodiscard]] std::optional<RawFrame> retrieve_into(cv::Mat buffer) override;
+    [[nodiscard]] Duration frame_interval() const override;
+    void rewind() override { position_ = 0; }
+    [[nodiscard]] bool seek_frame(size_t index) override;
+
+private:
+    std::vector<cv::Mat> frames_;
+    Duration interval_;
+    size_t clip_frames_ = 0;
+    size_t hold_frames_ = 1;
+    bool copy_frames_ = false;
+    size_t position_ = 0;
+    size_t grabbed_position_ = 0;
+    FrameId next_frame_id_ = 0;
+    FrameId grabbed_id_ = 0;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "asciinema/types.h"
+
+#include <opencv2/core/mat.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace asciinema {
+
+// Sum of absolute differences between two byte rows.
+using RowSadFn = uint64_t (*)(const uint8_t* a, const uint8_t* b, size_t bytes);
+
+uint64_t row_sad_scalar(const uint8_t* a, const uint8_t* b, size_t bytes);
+
+// Picks the widest kernel the CPU supports (AVX2, SSE2, scalar).
+[[nodiscard]] RowSadFn select_sad_kernel();
+[[nodiscard]] const char* sad_kernel_name(RowSadFn kernel);
+// Every kernel the CPU can run, widest first.
+[[nodiscard]] std::vector<RowSadFn> supported_sad_kernels();
+
+// Decode thread only. Spots decoded images that show the same picture as
+// the last one that went on to be processed (the reference), so slides,
+// paused screencasts and held shots skip processing and rendering.
+//
+// Only a few pixel rows per character row are compared, each on its own so
+// that a small change such as a moving cursor is not averaged away by the
+// rest of the picture. The sampled rows shift by one every frame, so a
+// change confined to rows that were skipped is still caught within a few
+// frames.
+class StillDetector {
+public:
+    // threshold is the mean absolute difference per byte that any sampled
+    // row may reach and still count as unchanged; zero only accepts
+    // identical rows and a negative threshold disables detection. A
+    // reference older than refresh is replaced even when nothing changed,
+    // which bounds how long a reference lost downstream can leave the
+    // screen stale.
+    void reset(int threshold, Duration refresh, int grid_rows);
+
+    [[nodiscard]] bool enabled() const { return threshold_ >= 0; }
+
+    // True when image repeats the reference. Otherwise image becomes the
+    // reference; it is kept by reference count, not copied.
+    [[nodiscard]] bool repeats(const cv::Mat& image, FrameId id, Duration pts);
+    [[nodiscard]] FrameId reference() const { return reference_id_; }
+
+    // The next image becomes the reference whatever it shows.
+    void forget() { reference_.release(); }
+
+private:
+    RowSadFn sad_ = row_sad_scalar;
+    int threshold_ = -1;
+    Duration refresh_{0};
+    int grid_rows_ = 1;
+    int phase_ = 0;
+    cv::Mat reference_;
+    FrameId reference_id_ = 0;
+    Duration reference_pts_{0};
+};
+
+}
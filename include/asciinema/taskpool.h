@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace asciinema {
+
+// Persistent helper threads that run one job's tasks together with the
+// thread that asks, for splitting a single frame into row bands.
+//
+// Tasks are dealt out as one contiguous share per thread. Each thread takes
+// tasks from the front of its own share and, once that is empty, steals from
+// the back of the others'. A share is a single word holding the job's
+// generation and the share's bounds, so taking a task is one CAS and a
+// helper that wakes up late for a finished job takes nothing. Helpers spin
+// briefly between jobs and then park.
+class TaskPool {
+public:
+    explicit TaskPool(size_t helpers);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Threads a job runs on, the caller included.
+    [[nodiscard]] size_t concurrency() const { return helpers_.size() + 1; }
+
+    // Runs task(i) for every i in [0, count) and returns once all have
+    // finished. A call made while another job is running, say from a second
+    // process worker, runs its tasks on the calling thread alone.
+    template <typename Task>
+    void run(size_t count, Task&& task) {
+        using Fn = std::remove_reference_t<Task>;
+        run_job(count, [](void* context, size_t i) { (*static_cast<Fn*>(context))(i); }, &task);
+    }
+
+    static constexpr size_t MAX_TASKS = 0xffff;
+
+private:
+    using TaskFn = void (*)(void* context, size_t index);
+
+    void run_job(size_t count, TaskFn fn, void* context);
+    void helper_loop(size_t participant);
+    // Runs tasks of job generation gen until none are left to take.
+    void work(size_t participant, uint32_t gen);
+    bool take(size_t share, uint32_t gen, bool from_back, size_t& index);
+
+    struct alignas(64) Share {
+        std::atomic<uint64_t> state{0};  // generation << 32 | front << 16 | back
+    };
+
+    std::vector<std::thread> helpers_;
+    std::unique_ptr<Share[]> shares_;  // one per participant; the caller's is 0
+
+    std::atomic<bool> busy_{false};
+    std::atomic<TaskFn> fn_{nullptr};
+    std::atomic<void*> context_{nullptr};
+    std::atomic<size_t> remaining_{0};
+    uint32_t generation_ = 0;  // written by the running caller only
+
+    std::atomic<uint32_t> epoch_{0};  // generation of the latest job
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> sleepers_{0};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "asciinema/frame.h"
+#include "asciinema/queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace asciinema {
+
+// Writes per-frame stage spans as Chrome trace-event JSON (loadable in
+// chrome://tracing and Perfetto). Each frame becomes an async "frame" span
+// with its waits and stage work nested inside, plus complete spans on the
+// decode, process and render threads' own tracks. The span's end event
+// says in its args whether the frame was dropped.
+//
+// The render thread hands over StageTimes with a single try_push; a
+// background thread formats them and writes in large chunks. Records that
+// find the queue full are counted and discarded rather than stalling playback.
+class TraceWriter {
+public:
+    explicit TraceWriter(size_t capacity = 1024) : queue_(capacity) {}
+    ~TraceWriter() { close(); }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // One trace per writer: fails if already opened.
+    [[nodiscard]] bool open(const std::string& path, size_t process_workers);
+    // Drains what is queued, finishes the JSON array and closes the file.
+    void close();
+    [[nodiscard]] bool is_open() const { return file_ != nullptr; }
+
+    // Render thread only. Frames dropped before drawing have no written time.
+    void record(FrameId id, const StageTimes& stages);
+    [[nodiscard]] uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        FrameId id = 0;
+        StageTimes stages;
+        [[nodiscard]] bool valid() const { return stages.decoded != TimePoint{}; }
+    };
+
+    void write_loop();
+    void write_record(const Record& record);
+    void complete(const char* name, int tid, TimePoint start, TimePoint end, FrameId id);
+    // args, if given, is a JSON object attached to the event.
+    void async(const char* name, char phase, TimePoint at, FrameId id, const char* args = nullptr);
+    void event(const char* json, int length);
+    void flush();
+    [[nodiscard]] double micros(TimePoint at) const;
+
+    SpscQueue<Record> queue_;
+    std::FILE* file_ = nullptr;
+    std::string buffer_;
+    TimePoint origin_{};
+    bool first_event_ = true;
+    std::thread thread_;
+    std::atomic<uint64_t> dropped_{0};
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "asciinema/metrics.h"
+#include "asciinema/types.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace asciinema {
+
+// Sends each frame to the terminal with a single write(). A frame is
+// assembled in a back buffer while the previous one may still be draining
+// from the front buffer. The terminal is reopened on a descriptor of its own
+// in non-blocking mode, so the shell's descriptor keeps its flags and a slow
+// terminal never stalls the render thread: whatever does not fit is written
+// on later flushes, and a frame that arrives before the previous one has
+// drained is discarded.
+//
+// Frames are wrapped in synchronized-update mode (DECSET 2026) when the
+// terminal reports supporting it, so it never shows one half-drawn.
+class TtyWriter {
+public:
+    explicit TtyWriter(Metrics& metrics) : metrics_(metrics) {}
+    ~TtyWriter() { close(); }
+
+    TtyWriter(const TtyWriter&) = delete;
+    TtyWriter& operator=(const TtyWriter&) = delete;
+
+    // Writes to fd itself, blocking, when it is not a terminal.
+    [[nodiscard]] bool open(int fd);
+    // Drains the last frame, waiting a bounded time, and closes.
+    void close();
+    [[nodiscard]] bool is_open() const { return fd_ >= 0; }
+    [[nodiscard]] bool synchronized() const { return synchronized_; }
+
+    // Starts a frame; append its bytes to the returned buffer.
+    [[nodiscard]] std::string& begin_frame();
+    // Sends the frame begun last. Returns false, discarding it, while the
+    // previous frame is still draining; the screen then still shows (part
+    // of) that frame.
+    bool submit();
+
+    // Writes what is left of the previous frame without blocking. Returns
+    // true once nothing is left.
+    bool flush();
+    // Keeps flushing as the terminal accepts bytes, until deadline.
+    void flush_until(TimePoint deadline);
+
+    // Mode switches outside of frames. Waits for the terminal.
+    void write_all(std::string_view bytes);
+
+private:
+    bool probe_synchronized();
+
+    Metrics& metrics_;
+    int fd_ = -1;
+    bool synchronized_ = false;
+    std::string back_;
+    std::string front_;
+    size_t sent_ = 0;  // bytes of front_ already written
+};
+
+}
@@ -6,7 +6,7 @@
 
 namespace asciinema {
 
-    using Clock = std::chrono::high_resolution_clock;
+    using Clock = std::chrono::steady_clock;
     using TimePoint = std::chrono::time_point<Clock>;
     using Duration = std::chrono::nanoseconds;
 
@@ -16,6 +16,10 @@ namespace asciinema {
         return std::chrono::duration<double, std::milli>(d).count();
     }
 
+    inline Duration from_ms(double ms) {
+        return std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::milli>(ms));
+    }
+
     using FrameId = uint64_t;
 
     struct Dimensions {
@@ -27,8 +31,20 @@ namespace asciinema {
     constexpr char ASCII_RAMP[] = "$@B%8&WM#*oahkbdpqwmZO0QLCJUYXzcvunxrjft/\\|()1{}[]?-_+~<>i!lI;:,\"^`'. ";
     constexpr size_t ASCII_RAMP_SIZE = sizeof(ASCII_RAMP) - 1;
 
+    // ASCII_RAMP entry for every intensity, built at compile time.
+    struct GlyphTable {
+        uint8_t glyph[256];
+
+        constexpr GlyphTable() : glyph{} {
+            for (int v = 0; v < 256; ++v)
+                glyph[v] = static_cast<uint8_t>(ASCII_RAMP[(v * (ASCII_RAMP_SIZE - 1)) / 255]);
+        }
+    };
+
+    inline constexpr GlyphTable GLYPHS;
+
     inline char pixel_to_char(uint8_t intensity) {
-        return ASCII_RAMP[(intensity * (ASCII_RAMP_SIZE - 1)) / 255];
+        return static_cast<char>(GLYPHS.glyph[intensity]);
     }
 
 } 
@@ -0,0 +1,290 @@
+#include "asciinema/bench.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+namespace asciinema {
+
+namespace {
+    const char* overflow_name(OverflowPolicy policy) {
+        switch (policy) {
+            case OverflowPolicy::Backpressure: return "backpressure";
+            case OverflowPolicy::DropOldest:   return "drop_oldest";
+            default:                           return "drop_newest";
+        }
+    }
+
+    const char* mode_name(RenderMode mode) {
+        switch (mode) {
+            case RenderMode::TrueColor:  return "truecolor";
+            case RenderMode::Palette256: return "palette256";
+            case RenderMode::Palette16:  return "palette16";
+            case RenderMode::HalfBlock:  return "halfblock";
+            default:                     return "ascii";
+        }
+    }
+
+    std::string json_escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    double per_second(uint64_t count, double seconds) {
+        return seconds > 0.0 ? static_cast<double>(count) / seconds : 0.0;
+    }
+
+    double thread_cpu_us() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) * 1e6 + static_cast<double>(ts.tv_nsec) / 1e3;
+    }
+
+    struct CursesResult {
+        double cpu_us = 0.0;
+        uint64_t bytes = 0;
+    };
+
+    // The pre-row renderer: erase, then one mvaddch per cell.
+    void draw_per_cell(WINDOW* win, const ProcessedFrame& frame) {
+        werase(win);
+        const CellGrid& cells = frame.cells;
+        const uint8_t* glyph = cells.glyph.data();
+        for (int y = 0; y < cells.dims.rows; ++y)
+            for (int x = 0; x < cells.dims.cols; ++x) mvwaddch(win, y, x, *glyph++);
+    }
+
+    CursesResult draw_frames(const std::vector<ProcessedFrame>& frames, Dimensions size, bool rows) {
+        CursesResult result;
+        std::FILE* sink = std::tmpfile();
+        if (!sink) return result;
+        {
+            TerminalRenderer renderer(sink, size);
+            double start = thread_cpu_us();
+            for (const ProcessedFrame& frame : frames) {
+                if (rows)
+                    renderer.render(frame);
+                else
+                    draw_per_cell(renderer.window(), frame);
+                renderer.refresh();
+            }
+            result.cpu_us = thread_cpu_us() - start;
+            std::fflush(sink);
+            struct stat st;
+            if (fstat(fileno(sink), &st) == 0) result.bytes = static_cast<uint64_t>(st.st_size);
+        }
+        std::fclose(sink);
+        return result;
+    }
+
+    int run_curses_bench(const BenchConfig& config, std::ostream& out) {
+        // Processed up front, so only drawing is timed.
+        SyntheticSource source(config.source_width, config.source_height, config.source_fps);
+        source.set_hold_frames(config.source_hold_frames);
+        FrameProcessor processor(config.size, RenderMode::ASCII);
+        std::vector<ProcessedFrame> frames;
+        while (frames.size() < config.frames && source.grab()) {
+            if (auto raw = source.retrieve()) frames.push_back(processor.process(*raw));
+        }
+        if (frames.empty()) return 1;
+
+        const CursesResult per_cell = draw_frames(frames, config.size, false);
+        const CursesResult rows = draw_frames(frames, config.size, true);
+        const double count = static_cast<double>(frames.size());
+
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+            "{\"bench\":\"curses\",\"grid\":[%d,%d],\"frames\":%zu,\"hold\":%zu,"
+            "\"per_cell\":{\"cpu_us_per_frame\":%.1f,\"bytes_per_frame\":%.1f},"
+            "\"rows\":{\"cpu_us_per_frame\":%.1f,\"bytes_per_frame\":%.1f}}",
+            config.size.cols, config.size.rows, frames.size(), config.source_hold_frames,
+            per_cell.cpu_us / count, static_cast<double>(per_cell.bytes) / count,
+            rows.cpu_us / count, static_cast<double>(rows.bytes) / count);
+        out << buf << std::endl;
+        return 0;
+    }
+
+    // The three-pass ASCII path the fused kernel replaced, and must match.
+    void reference_ascii(const cv::Mat& image, Dimensions size, cv::Mat& resized, cv::Mat& gray,
+                         std::vector<uint8_t>& glyphs) {
+        cv::resize(image, resized, cv::Size(size.cols, size.rows));
+        if (resized.channels() == 3)
+            cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
+        else if (resized.channels() == 4)
+            cv::cvtColor(resized, gray, cv::COLOR_BGRA2GRAY);
+        else
+            gray = resized;
+
+        glyphs.resize(static_cast<size_t>(size.area()));
+        uint8_t* glyph = glyphs.data();
+        for (int y = 0; y < gray.rows; ++y) {
+            const uint8_t* row = gray.ptr<uint8_t>(y);
+            for (int x = 0; x < gray.cols; ++x) *glyph++ = GLYPHS.glyph[row[x]];
+        }
+    }
+
+    int run_ascii_bench(const BenchConfig& config, std::ostream& out) {
+        SyntheticSource source(config.source_width, config.source_height, config.source_fps);
+        source.set_hold_frames(config.source_hold_frames);
+        std::vector<RawFrame> raws;
+        while (raws.size() < config.frames && source.grab()) {
+            if (auto raw = source.retrieve()) raws.push_back(std::move(*raw));
+        }
+        if (raws.empty()) return 1;
+
+        FrameProcessor processor(config.size, RenderMode::ASCII);
+        double start = thread_cpu_us();
+        for (const RawFrame& raw : raws) processor.recycle(processor.process(raw));
+        const double fused_us = thread_cpu_us() - start;
+
+        cv::Mat resized, gray;
+        std::vector<uint8_t> glyphs;
+        start = thread_cpu_us();
+        for (const RawFrame& raw : raws) reference_ascii(raw.image, config.size, resized, gray, glyphs);
+        const double reference_us = thread_cpu_us() - start;
+
+        size_t mismatched = 0;
+        for (const RawFrame& raw : raws) {
+            ProcessedFrame frame = processor.process(raw);
+            reference_ascii(raw.image, config.size, resized, gray, glyphs);
+            if (frame.cells.glyph != glyphs) ++mismatched;
+            processor.recycle(std::move(frame));
+        }
+
+        const double count = static_cast<double>(raws.size());
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+            "{\"bench\":\"ascii\",\"source\":[%d,%d],\"grid\":[%d,%d],\"frames\":%zu,\"kernel\":\"%s\","
+            "\"fused_us_per_frame\":%.1f,\"reference_us_per_frame\":%.1f,\"mismatched_frames\":%zu}",
+            config.source_width, config.source_height, config.size.cols, config.size.rows, raws.size(),
+            luma_kernel_name(select_luma_kernel()), fused_us / count, reference_us / count, mismatched);
+        out << buf << std::endl;
+        return mismatched == 0 ? 0 : 1;
+    }
+}
+
+int run_bench(const BenchConfig& config, std::ostream& out) {
+    if (config.curses) return run_curses_bench(config, out);
+    if (config.ascii_kernel) return run_ascii_bench(config, out);
+
+    PipelineConfig pipeline_config = config.pipeline;
+    pipeline_config.output = OutputTarget::Null;
+    pipeline_config.size = config.size;
+    pipeline_config.paced = config.paced;
+    pipeline_config.max_frames = config.frames > 0 ? config.frames : 1;
+
+    std::unique_ptr<FrameSource> source;
+    std::unique_ptr<FrameFileReader> replay;
+    std::string source_name;
+    if (config.video_path.empty()) {
+        auto synthetic = std::make_unique<SyntheticSource>(config.source_width, config.source_height,
+                                                           config.source_fps);
+        synthetic->set_clip_frames(config.source_clip_frames);
+        synthetic->set_hold_frames(config.source_hold_frames);
+        synthetic->set_copy_frames(config.source_copy);
+        source = std::move(synthetic);
+        source_name = "synthetic:" + std::to_string(config.source_width) + "x" +
+                      std::to_string(config.source_height);
+    } else if (FrameFileReader::is_frame_file(config.video_path)) {
+        // The file fixes the grid, the mode and a single producer.
+        replay = std::make_unique<FrameFileReader>();
+        if (!replay->open(config.video_path)) {
+            std::cerr << "Error: Could not open " << config.video_path << "\n";
+            return 1;
+        }
+        pipeline_config.size = replay->dimensions();
+        pipeline_config.mode = replay->mode();
+        pipeline_config.process_workers = 1;
+        source_name = json_escape(config.video_path);
+    } else {
+        auto decoder = std::make_unique<VideoDecoder>();
+        if (!decoder->open(config.video_path)) {
+            std::cerr << "Error: Could not open " << config.video_path << "\n";
+            return 1;
+        }
+        source = std::move(decoder);
+        source_name = json_escape(config.video_path);
+    }
+
+    Pipeline pipeline(config.decode_queue_size, config.render_queue_size);
+    auto started = now();
+    bool launched = replay ? pipeline.start(std::move(replay), pipeline_config)
+                           : pipeline.start(std::move(source), pipeline_config);
+    if (!launched) {
+        std::cerr << "Error: Could not start pipeline\n";
+        return 1;
+    }
+    while (pipeline.is_running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsed = to_ms(now() - started) / 1000.0;
+    pipeline.stop();
+
+    const Metrics& m = pipeline.metrics();
+    uint64_t decoded = m.frames_decoded.load();
+    uint64_t processed = m.frames_processed.load();
+    uint64_t rendered = m.frames_rendered.load();
+
+    char buf[3072];
+    snprintf(buf, sizeof(buf),
+        "{\"source\":\"%s\",\"mode\":\"%s\",\"grid\":[%d,%d],\"workers\":%zu,\"overflow\":\"%s\","
+        "\"paced\":%s,\"queues\":[%zu,%zu],\"elapsed_s\":%.3f,"
+        "\"fps\":{\"decode\":%.1f,\"process\":%.1f,\"render\":%.1f},"
+        "\"latency_ms\":%s,\"jitter_ms\":%s,"
+        "\"service_ms\":{\"decode\":%s,\"process\":%s,\"render\":%s},"
+        "\"wait_ms\":{\"process\":%s,\"render\":%s,\"pace\":%s},"
+        "\"frames\":{\"decoded\":%llu,\"skipped\":%llu,\"processed\":%llu,\"rendered\":%llu,\"dropped\":%llu,\"repeated\":%llu},"
+        "\"bytes\":{\"total\":%llu,\"per_frame\":%.1f},\"grid_allocations\":%llu,"
+        "\"quality\":{\"level\":%llu,\"changes\":%llu},"
+        "\"loop_cache\":{\"hits\":%llu,\"misses\":%llu,\"frames\":%llu},"
+        "\"image_pool\":{\"hits\":%llu,\"misses\":%llu,\"outstanding\":%llu}}",
+        source_name.c_str(),
+        mode_name(pipeline_config.mode),
+        pipeline_config.size.cols, pipeline_config.size.rows,
+        pipeline_config.process_workers,
+        overflow_name(pipeline_config.overflow),
+        config.paced ? "true" : "false",
+        config.decode_queue_size, config.render_queue_size,
+        elapsed,
+        per_second(decoded, elapsed), per_second(processed, elapsed), per_second(rendered, elapsed),
+        m.latency.snapshot().to_json().c_str(),
+        m.jitter.snapshot().to_json().c_str(),
+        m.decode_time.snapshot().to_json().c_str(),
+        m.process_time.snapshot().to_json().c_str(),
+        m.draw_time.snapshot().to_json().c_str(),
+        m.process_wait.snapshot().to_json().c_str(),
+        m.render_wait.snapshot().to_json().c_str(),
+        m.pace_wait.snapshot().to_json().c_str(),
+        static_cast<unsigned long long>(decoded),
+        static_cast<unsigned long long>(m.frames_skipped.load()),
+        static_cast<unsigned long long>(processed),
+        static_cast<unsigned long long>(rendered),
+        static_cast<unsigned long long>(m.frames_dropped.load()),
+        static_cast<unsigned long long>(m.frames_repeated.load()),
+        static_cast<unsigned long long>(m.bytes_rendered.load()),
+        m.bytes_per_frame(),
+        static_cast<unsigned long long>(m.grid_allocations.load()),
+        static_cast<unsigned long long>(m.quality_level.load()),
+        static_cast<unsigned long long>(m.quality_changes.load()),
+        static_cast<unsigned long long>(m.loop_cache_hits.load()),
+        static_cast<unsigned long long>(m.loop_cache_misses.load()),
+        static_cast<unsigned long long>(m.loop_cache_frames.load()),
+        static_cast<unsigned long long>(m.image_pool_hits.load()),
+        static_cast<unsigned long long>(m.image_pool_misses.load()),
+        static_cast<unsigned long long>(m.image_pool_outstanding.load())
+    );
+    out << buf << std::endl;
+    return 0;
+}
+
+}
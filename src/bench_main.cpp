@@ -0,0 +1,124 @@
+#include "asciinema/bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [OPTIONS] [video]\n\n"
+              << "Runs the pipeline headless and prints one JSON line of results.\n"
+              << "Without a video, frames are generated in memory. A frame file\n"
+              << "from -transcode is replayed at its own size and mode.\n\n"
+              << "Options:\n"
+              << "  -frames N      Frames to render (default: 600)\n"
+              << "  -size CxR      Character grid (default: 160x45)\n"
+              << "  -source WxH    Synthetic frame size (default: 1280x720)\n"
+              << "  -fps F         Synthetic frame rate (default: 30)\n"
+              << "  -clip N        End the synthetic clip after N frames and loop it\n"
+              << "  -hold N        Keep each synthetic picture up for N frames\n"
+              << "  -copy          Copy synthetic pictures into frame images like a decoder\n"
+              << "  -paced         Present on the playback clock instead of flat out\n"
+              << "  -queues D R    Decode and render queue sizes (default: 16 8)\n"
+              << "  -color         True color (24-bit) rendering\n"
+              << "  -palette N     256- or 16-color rendering\n"
+              << "  -dither        Ordered dithering with -palette\n"
+              << "  -halfblock     True color half blocks, two pixel rows per character\n"
+              << "  -bp            Enable backpressure (default: frame dropping)\n"
+              << "  -latest        Drop stale frames instead of new ones when behind\n"
+              << "  -tol N         Merge true color runs within N levels (default: 0)\n"
+              << "  -workers N     Process frames on N threads (default: 1)\n"
+              << "  -bands N       Split large frames into row bands on N more threads\n"
+              << "  -loop-cache MB Cache processed frames of a looping clip\n"
+              << "  -static N      Repeat frames within N levels per row of the last one\n"
+              << "  -curses        Time ncurses drawing per frame, per cell vs by row\n"
+              << "  -ascii         Time the fused ASCII kernel against cv::resize + cvtColor\n"
+              << "  -slo MS        Adapt quality to keep p95 latency under MS (needs -paced)\n"
+              << "  -trace FILE    Write per-frame stage spans as Chrome trace JSON\n"
+              << "  -help          Show this message\n";
+}
+
+int main(int argc, char* argv[]) {
+    using namespace asciinema;
+
+    BenchConfig config;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            config.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &config.size.cols, &config.size.rows);
+        else if (std::strcmp(argv[i], "-source") == 0 && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &config.source_width, &config.source_height);
+        else if (std::strcmp(argv[i], "-fps") == 0 && i + 1 < argc)
+            config.source_fps = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "-clip") == 0 && i + 1 < argc)
+            config.source_clip_frames = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-hold") == 0 && i + 1 < argc)
+            config.source_hold_frames = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-copy") == 0)
+            config.source_copy = true;
+        else if (std::strcmp(argv[i], "-static") == 0 && i + 1 < argc)
+            config.pipeline.static_threshold = std::max(std::atoi(argv[++i]), 0);
+        else if (std::strcmp(argv[i], "-loop-cache") == 0 && i + 1 < argc)
+            config.pipeline.loop_cache_bytes = std::strtoul(argv[++i], nullptr, 10) << 20;
+        else if (std::strcmp(argv[i], "-curses") == 0)
+            config.curses = true;
+        else if (std::strcmp(argv[i], "-ascii") == 0)
+            config.ascii_kernel = true;
+        else if (std::strcmp(argv[i], "-paced") == 0)
+            config.paced = true;
+        else if (std::strcmp(argv[i], "-queues") == 0 && i + 2 < argc) {
+            config.decode_queue_size = std::strtoul(argv[++i], nullptr, 10);
+            config.render_queue_size = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-color") == 0)
+            config.pipeline.mode = RenderMode::TrueColor;
+        else if (std::strcmp(argv[i], "-palette") == 0 && i + 1 < argc)
+            config.pipeline.mode = std::atoi(argv[++i]) == 16 ? RenderMode::Palette16 : RenderMode::Palette256;
+        else if (std::strcmp(argv[i], "-dither") == 0)
+            config.pipeline.dither = true;
+        else if (std::strcmp(argv[i], "-halfblock") == 0)
+            config.pipeline.mode = RenderMode::HalfBlock;
+        else if (std::strcmp(argv[i], "-bp") == 0)
+            config.pipeline.overflow = OverflowPolicy::Backpressure;
+        else if (std::strcmp(argv[i], "-latest") == 0)
+            config.pipeline.overflow = OverflowPolicy::DropOldest;
+        else if (std::strcmp(argv[i], "-tol") == 0 && i + 1 < argc)
+            config.pipeline.color_tolerance = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-workers") == 0 && i + 1 < argc) {
+            int workers = std::atoi(argv[++i]);
+            config.pipeline.process_workers = workers > 0 ? static_cast<size_t>(workers) : 1;
+        } else if (std::strcmp(argv[i], "-bands") == 0 && i + 1 < argc)
+            config.pipeline.band_threads = static_cast<size_t>(std::max(std::atoi(argv[++i]), 0));
+        else if (std::strcmp(argv[i], "-slo") == 0 && i + 1 < argc)
+            config.pipeline.latency_slo = std::chrono::milliseconds(std::max(std::atoi(argv[++i]), 0));
+        else if (std::strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+            config.pipeline.trace_path = argv[++i];
+        else if (std::strcmp(argv[i], "-help") == 0 || std::strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            config.video_path = argv[i];
+        }
+    }
+
+    if (config.size.area() <= 0 || config.source_width <= 0 || config.source_height <= 0) {
+        std::cerr << "Error: Sizes must be positive\n";
+        return 1;
+    }
+    if (config.pipeline.process_workers > MAX_PROCESS_WORKERS) {
+        std::cerr << "Error: -workers takes 1 to " << MAX_PROCESS_WORKERS << "\n";
+        return 1;
+    }
+    if (config.decode_queue_size == 0 || config.render_queue_size == 0) {
+        std::cerr << "Error: Queue sizes must be positive\n";
+        return 1;
+    }
+
+    return run_bench(config, std::cout);
+}
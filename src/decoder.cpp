@@ -26,6 +26,11 @@ void VideoDecoder::close() {
     if (capture_.isOpened()) capture_.release();
     path_.clear();
     next_frame_id_ = 0;
+    grabbed_id_ = 0;
+    grabbed_pts_ = Duration{0};
+    clip_pts_ = Duration{0};
+    pts_base_ = Duration{0};
+    grabbed_in_clip_ = false;
     fps_ = 0.0;
     total_frames_ = 0;
     width_ = 0;
@@ -33,14 +38,34 @@ void VideoDecoder::close() {
 }
 
 std::optional<RawFrame> VideoDecoder::next_frame() {
-    if (!capture_.isOpened()) return std::nullopt;
+    if (!grab()) return std::nullopt;
+    return retrieve();
+}
+
+bool VideoDecoder::grab() {
+    if (!capture_.isOpened() || !capture_.grab()) return false;
+
+    // Backends that report no (or non-increasing) timestamps fall back to
+    // the nominal frame interval.
+    Duration pts = from_ms(capture_.get(cv::CAP_PROP_POS_MSEC));
+    if (grabbed_in_clip_ && pts <= clip_pts_) pts = clip_pts_ + frame_interval();
+
+    clip_pts_ = pts;
+    grabbed_in_clip_ = true;
+    grabbed_pts_ = pts_base_ + pts;
+    grabbed_id_ = next_frame_id_++;
+    return true;
+}
+
+Duration VideoDecoder::grabbed_pts() const { return grabbed_pts_; }
 
-    cv::Mat image;
-    capture_ >> image;
+std::optional<RawFrame> VideoDecoder::retrieve() { return retrieve_into(cv::Mat()); }
 
-    if (image.empty()) return std::nullopt;
+// OpenCV converts into the buffer in place when its size and type match.
+std::optional<RawFrame> VideoDecoder::retrieve_into(cv::Mat buffer) {
+    if (!capture_.retrieve(buffer) || buffer.empty()) return std::nullopt;
 
-    return RawFrame(next_frame_id_++, now(), std::move(image));
+    return RawFrame(grabbed_id_, now(), std::move(buffer), grabbed_pts_);
 }
 
 double VideoDecoder::fps() const { return fps_; }
@@ -49,6 +74,8 @@ double VideoDecoder::frame_delay_ms() const {
     return fps_ > 0.0 ? 1000.0 / fps_ : 33.33;
 }
 
+Duration VideoDecoder::frame_interval() const { return from_ms(frame_delay_ms()); }
+
 int64_t VideoDecoder::total_frames() const { return total_frames_; }
 int VideoDecoder::width() const { return width_; }
 int VideoDecoder::height() const { return height_; }
@@ -67,6 +94,20 @@ void VideoDecoder::seek(int64_t frame_number) {
 void VideoDecoder::reset() {
     seek(0);
     next_frame_id_ = 0;
+    pts_base_ = Duration{0};
+    clip_pts_ = Duration{0};
+    grabbed_in_clip_ = false;
+}
+
+bool VideoDecoder::seek_frame(size_t index) {
+    return capture_.isOpened() && capture_.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(index));
+}
+
+void VideoDecoder::rewind() {
+    if (grabbed_in_clip_) pts_base_ += clip_pts_ + frame_interval();
+    clip_pts_ = Duration{0};
+    grabbed_in_clip_ = false;
+    seek(0);
 }
 
 }  
@@ -0,0 +1,332 @@
+#include "asciinema/delta.h"
+
+#include "asciinema/escape.h"
+
+namespace asciinema {
+
+namespace {
+    // Repainting a few unchanged cells is cheaper than another cursor move.
+    constexpr int MERGE_GAP = 6;
+
+    // Collects the runs of cells where changed(i) holds, row by row, i being
+    // the cell's row-major index. Returns the number of cells the runs cover.
+    template <typename Changed>
+    size_t collect_runs(Changed changed, Dimensions dims, std::vector<CellRun>& runs, size_t& changed_cells) {
+        size_t covered = 0;
+        for (int y = 0; y < dims.rows; ++y) {
+            const size_t row = static_cast<size_t>(y) * dims.cols;
+            int x = 0;
+            while (x < dims.cols) {
+                while (x < dims.cols && !changed(row + x)) ++x;
+                if (x == dims.cols) break;
+
+                int start = x;
+                int end = x;  // one past the last changed cell in the run
+                while (x < dims.cols) {
+                    if (changed(row + x)) {
+                        end = ++x;
+                        ++changed_cells;
+                    } else if (x - end < MERGE_GAP) {
+                        ++x;
+                    } else {
+                        break;
+                    }
+                }
+
+                runs.push_back({y, start, end - start});
+                covered += static_cast<size_t>(end - start);
+                x = end;
+            }
+        }
+        return covered;
+    }
+
+    // Starts an append of at most bound bytes; finish() trims the rest.
+    char* reserve(std::string& out, size_t bound) {
+        const size_t start = out.size();
+        out.resize(start + bound);
+        return out.data() + start;
+    }
+
+    void finish(std::string& out, const char* cursor) {
+        out.resize(static_cast<size_t>(cursor - out.data()));
+    }
+
+    // Background SGR for a cell of a color mode, and its length.
+    template <RenderMode Mode>
+    char* put_pen(char* out, uint32_t cell) {
+        if constexpr (Mode == RenderMode::Palette256)
+            return escape::put_bg_256(out, static_cast<uint8_t>(cell));
+        else if constexpr (Mode == RenderMode::Palette16)
+            return escape::put_bg_16(out, static_cast<uint8_t>(cell));
+        else
+            return escape::put_bg(out, static_cast<uint8_t>(cell >> 16), static_cast<uint8_t>(cell >> 8),
+                                  static_cast<uint8_t>(cell));
+    }
+
+    template <RenderMode Mode>
+    size_t pen_length(uint32_t cell) {
+        if constexpr (Mode == RenderMode::Palette256)
+            return escape::SGR_BG_256_LEN + escape::DECIMALS.length[cell & 0xff] + 1;
+        else if constexpr (Mode == RenderMode::Palette16)
+            return (cell & 0xff) >= 8 ? 6 : 5;
+        else
+            // Prefix, the three values, two separators and 'm'.
+            return escape::SGR_BG_LEN + escape::DECIMALS.length[(cell >> 16) & 0xff] +
+                   escape::DECIMALS.length[(cell >> 8) & 0xff] + escape::DECIMALS.length[cell & 0xff] + 3;
+    }
+
+    template <RenderMode Mode>
+    void put_color_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out) {
+        size_t bound = escape::SGR_RESET_LEN;
+        for (const CellRun& run : runs)
+            bound += escape::CURSOR_MOVE_MAX + static_cast<size_t>(run.length) * (escape::SGR_BG_MAX + 1);
+
+        char* cursor = reserve(out, bound);
+        bool pen_set = false;
+        uint32_t pen = 0;
+
+        for (const CellRun& run : runs) {
+            cursor = escape::put_cursor(cursor, run.row, run.col);
+            const uint32_t* cell = cells.bg.data() + static_cast<size_t>(run.row) * cells.dims.cols + run.col;
+            for (int i = 0; i < run.length; ++i) {
+                if (!pen_set || cell[i] != pen) {
+                    cursor = put_pen<Mode>(cursor, cell[i]);
+                    pen = cell[i];
+                    pen_set = true;
+                }
+                *cursor++ = ' ';
+            }
+        }
+        cursor = escape::put(cursor, escape::SGR_RESET, escape::SGR_RESET_LEN);
+        finish(out, cursor);
+    }
+
+    template <RenderMode Mode>
+    void put_color_grid(const CellGrid& cells, std::string& out) {
+        const size_t cols = static_cast<size_t>(cells.dims.cols);
+        const size_t rows = static_cast<size_t>(cells.dims.rows);
+
+        char* cursor = reserve(out, (cols * (escape::SGR_BG_MAX + 1) + escape::SGR_RESET_LEN + 1) * rows);
+        const uint32_t* cell = cells.bg.data();
+        for (size_t y = 0; y < rows; ++y) {
+            // A background SGR wherever the color changes along the row.
+            for (size_t x = 0; x < cols; ++x, ++cell) {
+                if (x == 0 || *cell != cell[-1]) cursor = put_pen<Mode>(cursor, *cell);
+                *cursor++ = ' ';
+            }
+            cursor = escape::put(cursor, escape::SGR_RESET, escape::SGR_RESET_LEN);
+            *cursor++ = '\n';
+        }
+        finish(out, cursor);
+    }
+
+    // The SGRs a half-block cell needs depend on the colors the cells before
+    // it left set. A cell whose halves match is a space on its background,
+    // which leaves the foreground alone.
+    struct HalfBlockPen {
+        bool fg_set = false;
+        bool bg_set = false;
+        uint32_t fg = 0;
+        uint32_t bg = 0;
+
+        // Appends one cell's SGRs and glyph when Write is set, and returns
+        // their length either way.
+        template <bool Write>
+        size_t cell(char*& out, uint32_t top, uint32_t bottom) {
+            const bool blank = top == bottom;
+            const bool new_bg = !bg_set || bottom != bg;
+            const bool new_fg = !blank && (!fg_set || top != fg);
+            size_t bytes = blank ? 1 : escape::UPPER_HALF_LEN;
+
+            if (new_fg && new_bg) {
+                bytes += escape::SGR_FG_LEN + escape::rgb_length(top) + escape::SGR_AND_BG_LEN +
+                         escape::rgb_length(bottom) + 1;
+                if constexpr (Write) out = escape::put_fg_bg(out, top, bottom);
+            } else if (new_fg) {
+                bytes += escape::SGR_FG_LEN + escape::rgb_length(top) + 1;
+                if constexpr (Write) out = escape::put_fg(out, top);
+            } else if (new_bg) {
+                bytes += escape::SGR_BG_LEN + escape::rgb_length(bottom) + 1;
+                if constexpr (Write)
+                    out = escape::put_bg(out, static_cast<uint8_t>(bottom >> 16), static_cast<uint8_t>(bottom >> 8),
+                                         static_cast<uint8_t>(bottom));
+            }
+            if (new_fg) {
+                fg = top;
+                fg_set = true;
+            }
+            bg = bottom;
+            bg_set = true;
+
+            if constexpr (Write) {
+                if (blank)
+                    *out++ = ' ';
+                else
+                    out = escape::put(out, escape::UPPER_HALF, escape::UPPER_HALF_LEN);
+            }
+            return bytes;
+        }
+    };
+
+    // Worst case for one half-block cell.
+    constexpr size_t HALF_BLOCK_CELL_MAX = escape::SGR_FG_BG_MAX + escape::UPPER_HALF_LEN;
+
+    void put_half_block_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out) {
+        size_t bound = escape::SGR_RESET_LEN;
+        for (const CellRun& run : runs)
+            bound += escape::CURSOR_MOVE_MAX + static_cast<size_t>(run.length) * HALF_BLOCK_CELL_MAX;
+
+        char* cursor = reserve(out, bound);
+        HalfBlockPen pen;
+        for (const CellRun& run : runs) {
+            cursor = escape::put_cursor(cursor, run.row, run.col);
+            const size_t first = static_cast<size_t>(run.row) * cells.dims.cols + run.col;
+            for (size_t i = first; i < first + static_cast<size_t>(run.length); ++i)
+                pen.cell<true>(cursor, cells.fg[i], cells.bg[i]);
+        }
+        cursor = escape::put(cursor, escape::SGR_RESET, escape::SGR_RESET_LEN);
+        finish(out, cursor);
+    }
+
+    // Every row starts from a reset pen, as the color rows do.
+    template <bool Write>
+    size_t half_block_grid(const CellGrid& cells, char*& cursor) {
+        const size_t cols = static_cast<size_t>(cells.dims.cols);
+        const size_t rows = static_cast<size_t>(cells.dims.rows);
+        size_t bytes = (escape::SGR_RESET_LEN + 1) * rows;
+        const uint32_t* fg = cells.fg.data();
+        const uint32_t* bg = cells.bg.data();
+        for (size_t y = 0; y < rows; ++y) {
+            HalfBlockPen pen;
+            for (size_t x = 0; x < cols; ++x, ++fg, ++bg) bytes += pen.cell<Write>(cursor, *fg, *bg);
+            if constexpr (Write) {
+                cursor = escape::put(cursor, escape::SGR_RESET, escape::SGR_RESET_LEN);
+                *cursor++ = '\n';
+            }
+        }
+        return bytes;
+    }
+
+    template <RenderMode Mode>
+    size_t color_grid_size(const CellGrid& cells) {
+        const size_t cols = static_cast<size_t>(cells.dims.cols);
+        const size_t rows = static_cast<size_t>(cells.dims.rows);
+        size_t bytes = (cols + escape::SGR_RESET_LEN + 1) * rows;
+        const uint32_t* cell = cells.bg.data();
+        for (size_t y = 0; y < rows; ++y) {
+            for (size_t x = 0; x < cols; ++x, ++cell)
+                if (x == 0 || *cell != cell[-1]) bytes += pen_length<Mode>(*cell);
+        }
+        return bytes;
+    }
+}
+
+bool DeltaTracker::diff(const ProcessedFrame& frame, std::vector<CellRun>& runs) {
+    runs.clear();
+    changed_cells_ = 0;
+
+    const CellGrid& next = frame.cells;
+    const size_t area = next.area();
+    if (!valid_ || next.dims.cols != screen_.dims.cols || next.dims.rows != screen_.dims.rows ||
+        next.mode != screen_.mode) {
+        changed_cells_ = area;
+        return false;
+    }
+
+    size_t covered;
+    if (next.mode == RenderMode::HalfBlock) {
+        const uint32_t* fg = next.fg.data();
+        const uint32_t* bg = next.bg.data();
+        const uint32_t* shown_fg = screen_.fg.data();
+        const uint32_t* shown_bg = screen_.bg.data();
+        covered = collect_runs([&](size_t i) { return fg[i] != shown_fg[i] || bg[i] != shown_bg[i]; }, next.dims,
+                               runs, changed_cells_);
+    } else if (is_color(next.mode)) {
+        const uint32_t* bg = next.bg.data();
+        const uint32_t* shown_bg = screen_.bg.data();
+        covered = collect_runs([&](size_t i) { return bg[i] != shown_bg[i]; }, next.dims, runs, changed_cells_);
+    } else {
+        const uint8_t* glyph = next.glyph.data();
+        const uint8_t* shown_glyph = screen_.glyph.data();
+        covered = collect_runs([&](size_t i) { return glyph[i] != shown_glyph[i]; }, next.dims, runs,
+                               changed_cells_);
+    }
+
+    // Mostly-changed frames repaint faster in one pass.
+    return covered * 4 <= area * 3;
+}
+
+void DeltaTracker::present(ProcessedFrame& frame) {
+    screen_.swap(frame.cells);
+    valid_ = !screen_.empty();
+}
+
+void DeltaTracker::invalidate() { valid_ = false; }
+
+void encode_color_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out) {
+    switch (cells.mode) {
+        case RenderMode::Palette256: return put_color_runs<RenderMode::Palette256>(cells, runs, out);
+        case RenderMode::Palette16: return put_color_runs<RenderMode::Palette16>(cells, runs, out);
+        case RenderMode::HalfBlock: return put_half_block_runs(cells, runs, out);
+        default: return put_color_runs<RenderMode::TrueColor>(cells, runs, out);
+    }
+}
+
+void encode_ascii_runs(const CellGrid& cells, const std::vector<CellRun>& runs, std::string& out) {
+    size_t bound = 0;
+    for (const CellRun& run : runs) bound += escape::CURSOR_MOVE_MAX + static_cast<size_t>(run.length);
+
+    char* cursor = reserve(out, bound);
+    for (const CellRun& run : runs) {
+        cursor = escape::put_cursor(cursor, run.row, run.col);
+        cursor = escape::put(cursor,
+                             reinterpret_cast<const char*>(cells.glyph.data()) +
+                                 static_cast<size_t>(run.row) * cells.dims.cols + run.col,
+                             static_cast<size_t>(run.length));
+    }
+    finish(out, cursor);
+}
+
+void encode_grid(const CellGrid& cells, std::string& out) {
+    const size_t cols = static_cast<size_t>(cells.dims.cols);
+    const size_t rows = static_cast<size_t>(cells.dims.rows);
+
+    switch (cells.mode) {
+        case RenderMode::ASCII: {
+            char* cursor = reserve(out, (cols + 1) * rows);
+            const char* glyph = reinterpret_cast<const char*>(cells.glyph.data());
+            for (size_t y = 0; y < rows; ++y, glyph += cols) {
+                cursor = escape::put(cursor, glyph, cols);
+                *cursor++ = '\n';
+            }
+            finish(out, cursor);
+            return;
+        }
+        case RenderMode::Palette256: return put_color_grid<RenderMode::Palette256>(cells, out);
+        case RenderMode::Palette16: return put_color_grid<RenderMode::Palette16>(cells, out);
+        case RenderMode::HalfBlock: {
+            char* cursor = reserve(out, (cols * HALF_BLOCK_CELL_MAX + escape::SGR_RESET_LEN + 1) * rows);
+            half_block_grid<true>(cells, cursor);
+            finish(out, cursor);
+            return;
+        }
+        default: return put_color_grid<RenderMode::TrueColor>(cells, out);
+    }
+}
+
+size_t encoded_grid_size(const CellGrid& cells) {
+    switch (cells.mode) {
+        case RenderMode::ASCII:
+            return (static_cast<size_t>(cells.dims.cols) + 1) * static_cast<size_t>(cells.dims.rows);
+        case RenderMode::Palette256: return color_grid_size<RenderMode::Palette256>(cells);
+        case RenderMode::Palette16: return color_grid_size<RenderMode::Palette16>(cells);
+        case RenderMode::HalfBlock: {
+            char* unused = nullptr;
+            return half_block_grid<false>(cells, unused);
+        }
+        default: return color_grid_size<RenderMode::TrueColor>(cells);
+    }
+}
+
+}
@@ -0,0 +1,298 @@
+#include "asciinema/exporter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace asciinema {
+
+namespace {
+    constexpr int REQUEST_WAIT_MS = 100;
+
+    void append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    void append(std::string& out, const char* format, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (n > 0) out.append(buf, std::min(static_cast<size_t>(n), sizeof(buf) - 1));
+    }
+
+    void header(std::string& out, const char* name, const char* type, const char* help) {
+        append(out, "# HELP asciinema_%s %s\n# TYPE asciinema_%s %s\n", name, help, name, type);
+    }
+
+    // Latencies as a Prometheus summary, in seconds.
+    void summary(std::string& out, const char* name, const char* labels, const HistogramSnapshot& h) {
+        const char* sep = *labels ? "," : "";
+        for (double q : {0.5, 0.95, 0.99, 0.999})
+            append(out, "asciinema_%s{%s%squantile=\"%g\"} %.6f\n", name, labels, sep, q, h.percentile(q * 100.0) / 1000.0);
+
+        std::string braced = *labels ? std::string("{") + labels + "}" : std::string();
+        append(out, "asciinema_%s_sum%s %.6f\n", name, braced.c_str(), h.sum() / 1000.0);
+        append(out, "asciinema_%s_count%s %llu\n", name, braced.c_str(), static_cast<unsigned long long>(h.count()));
+    }
+
+    void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    void send_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                pollfd p{fd, POLLOUT, 0};
+                if (poll(&p, 1, REQUEST_WAIT_MS) <= 0) return;
+            } else {
+                return;
+            }
+        }
+    }
+}
+
+bool MetricsExporter::start(const ExporterConfig& config) {
+    if (running_) return false;
+    config_ = config;
+
+    if (!config_.json_path.empty()) {
+        json_ = std::fopen(config_.json_path.c_str(), "a");
+        if (!json_) return false;
+    }
+
+    if (!config_.socket_path.empty()) {
+        sockaddr_un addr{};
+        if (config_.socket_path.size() >= sizeof(addr.sun_path)) {
+            close_all();
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, config_.socket_path.c_str(), config_.socket_path.size() + 1);
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(config_.socket_path.c_str());  // stale socket from an earlier run
+        if (listen_fd_ < 0 ||
+            bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd_, 8) != 0) {
+            close_all();
+            return false;
+        }
+        set_nonblocking(listen_fd_);
+    }
+
+    // Self-pipe so stop() can interrupt the poll() between samples.
+    if (pipe(wake_fds_) != 0) {
+        close_all();
+        return false;
+    }
+
+    sample();
+    running_ = true;
+    thread_ = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (running_.exchange(false)) {
+        char byte = 0;
+        ssize_t ignored = write(wake_fds_[1], &byte, 1);
+        (void)ignored;
+    }
+    if (thread_.joinable()) thread_.join();
+    close_all();
+}
+
+void MetricsExporter::close_all() {
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(config_.socket_path.c_str());
+        listen_fd_ = -1;
+    }
+    for (int& fd : wake_fds_) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    if (json_) {
+        std::fclose(json_);
+        json_ = nullptr;
+    }
+}
+
+void MetricsExporter::run() {
+    TimePoint next = now() + config_.interval;
+
+    while (running_) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now());
+        pollfd fds[2] = {{wake_fds_[0], POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+        int ready = poll(fds, listen_fd_ >= 0 ? 2 : 1, std::max<int>(static_cast<int>(wait.count()), 0));
+
+        if (ready > 0 && (fds[1].revents & POLLIN)) {
+            int client;
+            while ((client = accept(listen_fd_, nullptr, nullptr)) >= 0) {
+                serve(client);
+                close(client);
+            }
+        }
+        if (now() >= next) {
+            sample();
+            next += config_.interval;
+            if (next < now()) next = now() + config_.interval;
+        }
+    }
+}
+
+void MetricsExporter::sample() {
+    exposition_ = prometheus_text();
+    if (json_) {
+        std::string line = json_line();
+        std::fwrite(line.data(), 1, line.size(), json_);
+        std::fflush(json_);
+    }
+}
+
+// Waits briefly for a request so HTTP clients get a clean exchange; anything
+// that connects and sends nothing still gets the exposition.
+void MetricsExporter::serve(int client) const {
+    set_nonblocking(client);
+    pollfd p{client, POLLIN, 0};
+    if (poll(&p, 1, REQUEST_WAIT_MS) > 0) {
+        char request[1024];
+        ssize_t ignored = recv(client, request, sizeof(request), 0);
+        (void)ignored;
+    }
+
+    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: ";
+    response += std::to_string(exposition_.size());
+    response += "\r\n\r\n";
+    response += exposition_;
+    send_all(client, response);
+}
+
+std::string MetricsExporter::prometheus_text() const {
+    const Metrics& m = pipeline_.metrics();
+    std::string out;
+    out.reserve(8192);
+
+    header(out, "frames_total", "counter", "Frames by pipeline event.");
+    append(out, "asciinema_frames_total{event=\"decoded\"} %llu\n", static_cast<unsigned long long>(m.frames_decoded.load()));
+    append(out, "asciinema_frames_total{event=\"skipped\"} %llu\n", static_cast<unsigned long long>(m.frames_skipped.load()));
+    append(out, "asciinema_frames_total{event=\"processed\"} %llu\n", static_cast<unsigned long long>(m.frames_processed.load()));
+    append(out, "asciinema_frames_total{event=\"rendered\"} %llu\n", static_cast<unsigned long long>(m.frames_rendered.load()));
+    append(out, "asciinema_frames_total{event=\"dropped\"} %llu\n", static_cast<unsigned long long>(m.frames_dropped.load()));
+    append(out, "asciinema_frames_total{event=\"repeated\"} %llu\n", static_cast<unsigned long long>(m.frames_repeated.load()));
+
+    header(out, "bytes_rendered_total", "counter", "Bytes of terminal output.");
+    append(out, "asciinema_bytes_rendered_total %llu\n", static_cast<unsigned long long>(m.bytes_rendered.load()));
+    header(out, "grid_allocations_total", "counter", "Output grid buffer allocations.");
+    append(out, "asciinema_grid_allocations_total %llu\n", static_cast<unsigned long long>(m.grid_allocations.load()));
+
+    header(out, "fps", "gauge", "Frames per second over the last second.");
+    append(out, "asciinema_fps{stage=\"decode\"} %.1f\n", m.decode_fps.fps());
+    append(out, "asciinema_fps{stage=\"process\"} %.1f\n", m.process_fps.fps());
+    append(out, "asciinema_fps{stage=\"render\"} %.1f\n", m.render_fps.fps());
+
+    header(out, "queue_depth", "gauge", "Frames waiting in a stage queue.");
+    append(out, "asciinema_queue_depth{queue=\"decode\"} %zu\n", pipeline_.decode_queue_depth());
+    append(out, "asciinema_queue_depth{queue=\"render\"} %zu\n", pipeline_.render_queue_depth());
+    header(out, "queue_capacity", "gauge", "Stage queue capacity.");
+    append(out, "asciinema_queue_capacity{queue=\"decode\"} %zu\n", pipeline_.decode_queue_capacity());
+    append(out, "asciinema_queue_capacity{queue=\"render\"} %zu\n", pipeline_.render_queue_capacity());
+
+    header(out, "quality_level", "gauge", "Adaptive quality rung, 0 is full quality.");
+    append(out, "asciinema_quality_level %llu\n", static_cast<unsigned long long>(m.quality_level.load()));
+    header(out, "quality_changes_total", "counter", "Adaptive quality level changes.");
+    append(out, "asciinema_quality_changes_total %llu\n", static_cast<unsigned long long>(m.quality_changes.load()));
+
+    header(out, "loop_cache_total", "counter", "Frames by loop cache result.");
+    append(out, "asciinema_loop_cache_total{result=\"hit\"} %llu\n", static_cast<unsigned long long>(m.loop_cache_hits.load()));
+    append(out, "asciinema_loop_cache_total{result=\"miss\"} %llu\n", static_cast<unsigned long long>(m.loop_cache_misses.load()));
+    header(out, "loop_cache_frames", "gauge", "Clip positions held in the loop cache.");
+    append(out, "asciinema_loop_cache_frames %llu\n", static_cast<unsigned long long>(m.loop_cache_frames.load()));
+    header(out, "image_pool_total", "counter", "Decoded frames by image pool result.");
+    append(out, "asciinema_image_pool_total{result=\"hit\"} %llu\n", static_cast<unsigned long long>(m.image_pool_hits.load()));
+    append(out, "asciinema_image_pool_total{result=\"miss\"} %llu\n", static_cast<unsigned long long>(m.image_pool_misses.load()));
+    header(out, "image_pool_outstanding", "gauge", "Pooled images still held by a frame.");
+    append(out, "asciinema_image_pool_outstanding %llu\n", static_cast<unsigned long long>(m.image_pool_outstanding.load()));
+    header(out, "tty_total", "counter", "Terminal writer frames and write() calls.");
+    append(out, "asciinema_tty_total{event=\"frame\"} %llu\n", static_cast<unsigned long long>(m.tty_frames.load()));
+    append(out, "asciinema_tty_total{event=\"write\"} %llu\n", static_cast<unsigned long long>(m.tty_writes.load()));
+    append(out, "asciinema_tty_total{event=\"stall\"} %llu\n", static_cast<unsigned long long>(m.tty_stalls.load()));
+    append(out, "asciinema_tty_total{event=\"unsent\"} %llu\n", static_cast<unsigned long long>(m.tty_unsent.load()));
+    header(out, "tty_write_seconds", "summary", "Time in write() per flush of a frame to the terminal.");
+    summary(out, "tty_write_seconds", "", m.tty_write_time.snapshot());
+
+    header(out, "latency_seconds", "summary", "Decoded to written.");
+    summary(out, "latency_seconds", "", m.latency.snapshot());
+    header(out, "jitter_seconds", "summary", "Distance of presentation from its due time.");
+    summary(out, "jitter_seconds", "", m.jitter.snapshot());
+
+    header(out, "service_seconds", "summary", "Time a stage spent working on a frame.");
+    summary(out, "service_seconds", "stage=\"decode\"", m.decode_time.snapshot());
+    summary(out, "service_seconds", "stage=\"process\"", m.process_time.snapshot());
+    summary(out, "service_seconds", "stage=\"render\"", m.draw_time.snapshot());
+
+    header(out, "wait_seconds", "summary", "Time a frame waited before a stage.");
+    summary(out, "wait_seconds", "stage=\"process\"", m.process_wait.snapshot());
+    summary(out, "wait_seconds", "stage=\"render\"", m.render_wait.snapshot());
+    summary(out, "wait_seconds", "stage=\"pace\"", m.pace_wait.snapshot());
+    return out;
+}
+
+std::string MetricsExporter::json_line() const {
+    const Metrics& m = pipeline_.metrics();
+    auto unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::string out;
+    out.reserve(2048);
+    append(out, "{\"ts_ms\":%lld,\"fps\":{\"decode\":%.1f,\"process\":%.1f,\"render\":%.1f},",
+        static_cast<long long>(unix_ms), m.decode_fps.fps(), m.process_fps.fps(), m.render_fps.fps());
+    append(out, "\"frames\":{\"decoded\":%llu,\"skipped\":%llu,\"processed\":%llu,\"rendered\":%llu,\"dropped\":%llu,\"repeated\":%llu},",
+        static_cast<unsigned long long>(m.frames_decoded.load()),
+        static_cast<unsigned long long>(m.frames_skipped.load()),
+        static_cast<unsigned long long>(m.frames_processed.load()),
+        static_cast<unsigned long long>(m.frames_rendered.load()),
+        static_cast<unsigned long long>(m.frames_dropped.load()),
+        static_cast<unsigned long long>(m.frames_repeated.load()));
+    append(out, "\"quality_level\":%llu,", static_cast<unsigned long long>(m.quality_level.load()));
+    append(out, "\"loop_cache\":{\"hits\":%llu,\"misses\":%llu,\"frames\":%llu},",
+        static_cast<unsigned long long>(m.loop_cache_hits.load()),
+        static_cast<unsigned long long>(m.loop_cache_misses.load()),
+        static_cast<unsigned long long>(m.loop_cache_frames.load()));
+    append(out, "\"image_pool\":{\"hits\":%llu,\"misses\":%llu,\"outstanding\":%llu},",
+        static_cast<unsigned long long>(m.image_pool_hits.load()),
+        static_cast<unsigned long long>(m.image_pool_misses.load()),
+        static_cast<unsigned long long>(m.image_pool_outstanding.load()));
+    append(out, "\"tty\":{\"frames\":%llu,\"writes\":%llu,\"stalls\":%llu,\"unsent\":%llu},",
+        static_cast<unsigned long long>(m.tty_frames.load()),
+        static_cast<unsigned long long>(m.tty_writes.load()),
+        static_cast<unsigned long long>(m.tty_stalls.load()),
+        static_cast<unsigned long long>(m.tty_unsent.load()));
+    append(out, "\"queues\":{\"decode\":[%zu,%zu],\"render\":[%zu,%zu]},\"bytes_rendered\":%llu,",
+        pipeline_.decode_queue_depth(), pipeline_.decode_queue_capacity(),
+        pipeline_.render_queue_depth(), pipeline_.render_queue_capacity(),
+        static_cast<unsigned long long>(m.bytes_rendered.load()));
+    out += "\"latency_ms\":" + m.latency.snapshot().to_json();
+    out += ",\"jitter_ms\":" + m.jitter.snapshot().to_json();
+    out += ",\"service_ms\":{\"decode\":" + m.decode_time.snapshot().to_json();
+    out += ",\"process\":" + m.process_time.snapshot().to_json();
+    out += ",\"render\":" + m.draw_time.snapshot().to_json();
+    out += "},\"wait_ms\":{\"process\":" + m.process_wait.snapshot().to_json();
+    out += ",\"render\":" + m.render_wait.snapshot().to_json();
+    out += ",\"pace\":" + m.pace_wait.snapshot().to_json();
+    out += "}}\n";
+    return out;
+}
+
+}
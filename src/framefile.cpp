@@ -0,0 +1,246 @@
+#include "asciinema/framefile.h"
+
+#include "asciinema/processor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace asciinema {
+
+namespace {
+    constexpr char MAGIC[8] = {'A', 'S', 'C', 'I', 'I', 'F', 'R', 'M'};
+    constexpr uint32_t VERSION = 1;
+    constexpr int MAX_SIDE = 10000;  // keeps area() within int
+
+    void put_u32(std::string& out, uint32_t value) {
+        char bytes[4];
+        std::memcpy(bytes, &value, 4);
+        out.append(bytes, 4);
+    }
+
+    uint32_t get_u32(const uint8_t* in) {
+        uint32_t value;
+        std::memcpy(&value, in, 4);
+        return value;
+    }
+
+    void put_cells(std::string& out, const CellGrid& cells, size_t first, size_t count) {
+        const size_t start = out.size();
+        out.resize(start + count * cell_bytes(cells.mode));
+        store_cells(cells, first, count, reinterpret_cast<uint8_t*>(out.data() + start));
+    }
+}
+
+bool FrameFileWriter::open(const std::string& path, Dimensions dims, RenderMode mode, Duration frame_interval) {
+    if (file_ || dims.cols <= 0 || dims.rows <= 0 || dims.cols > MAX_SIDE || dims.rows > MAX_SIDE) return false;
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) return false;
+
+    header_ = {};
+    std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+    header_.version = VERSION;
+    header_.mode = static_cast<uint32_t>(mode);
+    header_.cols = static_cast<uint32_t>(dims.cols);
+    header_.rows = static_cast<uint32_t>(dims.rows);
+    header_.frame_interval_ns = frame_interval.count();
+
+    screen_.invalidate();
+    index_.clear();
+    offset_ = 0;
+    failed_ = false;
+
+    // Rewritten with the frame count and index offset on close().
+    return write(&header_, sizeof(header_));
+}
+
+bool FrameFileWriter::write(const void* data, size_t size) {
+    if (size == 0) return !failed_;  // an empty index may have no storage at all
+    if (std::fwrite(data, 1, size, file_) != size) failed_ = true;
+    offset_ += size;
+    return !failed_;
+}
+
+bool FrameFileWriter::append(ProcessedFrame& frame) {
+    const CellGrid& cells = frame.cells;
+    const int cols = static_cast<int>(header_.cols);
+    if (!file_ || cells.mode != static_cast<RenderMode>(header_.mode) || cells.dims.cols != cols ||
+        cells.dims.rows != static_cast<int>(header_.rows) || cells.empty())
+        return false;
+
+    const bool delta = screen_.diff(frame, runs_);
+    payload_.clear();
+    if (delta) {
+        put_u32(payload_, static_cast<uint32_t>(runs_.size()));
+        for (const CellRun& run : runs_) {
+            const size_t first = static_cast<size_t>(run.row) * cols + run.col;
+            put_u32(payload_, static_cast<uint32_t>(first));
+            put_u32(payload_, static_cast<uint32_t>(run.length));
+            put_cells(payload_, cells, first, static_cast<size_t>(run.length));
+        }
+    } else {
+        put_u32(payload_, 1);
+        put_u32(payload_, 0);
+        put_u32(payload_, static_cast<uint32_t>(cells.area()));
+        put_cells(payload_, cells, 0, cells.area());
+    }
+
+    index_.push_back({frame.pts.count(), offset_, static_cast<uint32_t>(payload_.size()),
+                      delta ? 0u : FRAME_FILE_KEY});
+    screen_.present(frame);
+    return write(payload_.data(), payload_.size());
+}
+
+bool FrameFileWriter::close() {
+    if (!file_) return false;
+
+    header_.frame_count = index_.size();
+    header_.index_offset = offset_;
+    write(index_.data(), index_.size() * sizeof(FrameFileIndexEntry));
+    if (std::fseek(file_, 0, SEEK_SET) != 0) failed_ = true;
+    if (!failed_ && std::fwrite(&header_, 1, sizeof(header_), file_) != sizeof(header_)) failed_ = true;
+    if (std::fclose(file_) != 0) failed_ = true;
+    file_ = nullptr;
+    return !failed_;
+}
+
+bool FrameFileReader::is_frame_file(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    char magic[sizeof(MAGIC)];
+    const bool match = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                       std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    std::fclose(file);
+    return match;
+}
+
+bool FrameFileReader::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data_ = static_cast<const uint8_t*>(mapped);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    const bool valid =
+        std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) == 0 && header_.version == VERSION &&
+        header_.mode <= static_cast<uint32_t>(RenderMode::HalfBlock) &&
+        header_.cols > 0 && header_.cols <= MAX_SIDE && header_.rows > 0 && header_.rows <= MAX_SIDE &&
+        header_.frame_interval_ns > 0 && header_.frame_count > 0 &&
+        header_.index_offset >= sizeof(FrameFileHeader) && header_.index_offset <= size_ &&
+        header_.frame_count <= (size_ - header_.index_offset) / sizeof(FrameFileIndexEntry);
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    // Looping playback revisits every page; keep the whole file resident.
+    madvise(mapped, size_, MADV_WILLNEED);
+
+    index_ = data_ + header_.index_offset;
+    dims_ = {static_cast<int>(header_.cols), static_cast<int>(header_.rows)};
+    mode_ = static_cast<RenderMode>(header_.mode);
+    cells_.reset(dims_, mode_);
+    std::fill(cells_.glyph.begin(), cells_.glyph.end(), 0);
+    std::fill(cells_.fg.begin(), cells_.fg.end(), 0);
+    std::fill(cells_.bg.begin(), cells_.bg.end(), 0);
+    next_ = 0;
+    next_id_ = 0;
+    clip_pts_ = Duration{0};
+    pts_base_ = Duration{0};
+    return true;
+}
+
+void FrameFileReader::close() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    index_ = nullptr;
+    size_ = 0;
+    header_ = {};
+}
+
+bool FrameFileReader::next(ProcessedFrame& frame) {
+    if (!data_ || next_ >= header_.frame_count) return false;
+
+    FrameFileIndexEntry entry;
+    std::memcpy(&entry, index_ + next_ * sizeof(entry), sizeof(entry));
+    ++next_;
+    // A damaged entry leaves the previous picture on screen.
+    if (entry.offset >= sizeof(FrameFileHeader) && entry.offset <= header_.index_offset &&
+        entry.size <= header_.index_offset - entry.offset)
+        apply(data_ + entry.offset, entry.size);
+
+    const size_t capacity = frame.cells.capacity();
+    frame.cells = cells_;
+    if (frame.cells.capacity() != capacity) ++allocations_;
+
+    clip_pts_ = Duration(entry.pts_ns);
+    frame.id = next_id_++;
+    frame.pts = pts_base_ + clip_pts_;
+    return true;
+}
+
+void FrameFileReader::rewind() {
+    if (next_ > 0) pts_base_ += clip_pts_ + frame_interval();
+    clip_pts_ = Duration{0};
+    next_ = 0;
+}
+
+// Runs that fall outside the grid or the payload end decoding early.
+void FrameFileReader::apply(const uint8_t* payload, size_t size) {
+    if (size < 4) return;
+    const uint32_t count = get_u32(payload);
+    const size_t width = cell_bytes(mode_);
+    const size_t area = cells_.area();
+    size_t pos = 4;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (size - pos < 8) return;
+        const size_t first = get_u32(payload + pos);
+        const size_t length = get_u32(payload + pos + 4);
+        pos += 8;
+        if (first > area || length > area - first || length > (size - pos) / width) return;
+
+        load_cells(payload + pos, first, length, cells_);
+        pos += length * width;
+    }
+}
+
+uint64_t transcode(FrameSource& source, const std::string& path, Dimensions dims, RenderMode mode,
+                   int color_tolerance, bool dither) {
+    FrameProcessor processor(dims, mode);
+    processor.set_color_tolerance(color_tolerance);
+    processor.set_dithering(dither);
+
+    FrameFileWriter writer;
+    if (!writer.open(path, dims, mode, source.frame_interval())) return 0;
+
+    while (source.grab()) {
+        auto raw = source.retrieve();
+        if (!raw) continue;
+        ProcessedFrame frame = processor.process(*raw);
+        if (!writer.append(frame)) {
+            writer.close();
+            return 0;
+        }
+        processor.recycle(std::move(frame));
+    }
+
+    const uint64_t frames = writer.frames();
+    return writer.close() && frames > 0 ? frames : 0;
+}
+
+}
@@ -0,0 +1,77 @@
+#include "asciinema/loopcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace asciinema {
+
+void LoopCache::reset(Dimensions dims, RenderMode mode, size_t budget_bytes) {
+    dims_ = dims;
+    mode_ = mode;
+    frame_bytes_ = static_cast<size_t>(std::max(dims.area(), 0)) * cell_bytes(mode);
+    capacity_ = frame_bytes_ ? std::min<size_t>(budget_bytes / frame_bytes_, std::numeric_limits<uint32_t>::max()) : 0;
+    // Left uninitialised: pages are only committed as frames are stored.
+    arena_.reset(capacity_ ? new uint8_t[capacity_ * frame_bytes_] : nullptr);
+    size_.store(0, std::memory_order_relaxed);
+}
+
+bool LoopCache::insert(const ProcessedFrame& frame) {
+    const size_t next = size_.load(std::memory_order_relaxed);
+    if (next >= capacity_ || frame.clip_index != next) return false;
+
+    // Every position since the picture it repeats was a repeat too, or the
+    // cache would have stopped at the gap, so the previous entry holds it.
+    if (frame.repeat) {
+        if (next == 0) return false;
+        uint8_t* entry = arena_.get() + next * frame_bytes_;
+        std::memcpy(entry, entry - frame_bytes_, frame_bytes_);
+        size_.store(next + 1, std::memory_order_release);
+        return true;
+    }
+
+    const CellGrid& cells = frame.cells;
+    if (cells.mode != mode_ || cells.dims.cols != dims_.cols || cells.dims.rows != dims_.rows || cells.empty())
+        return false;
+
+    store_cells(cells, 0, cells.area(), arena_.get() + next * frame_bytes_);
+    size_.store(next + 1, std::memory_order_release);
+    return true;
+}
+
+void LoopCache::load(const RawFrame& raw, ProcessedFrame& frame) const {
+    frame.cells.reset(dims_, mode_);
+    load_cells(arena_.get() + raw.clip_index * frame_bytes_, 0, frame.cells.area(), frame.cells);
+
+    frame.id = raw.id;
+    frame.timestamp = raw.timestamp;
+    frame.pts = raw.pts;
+    frame.stages = raw.stages;
+    frame.clip_index = raw.clip_index;
+}
+
+Duration LoopTimeline::pts(Duration source_pts) {
+    if (learned()) return pts();
+    if (index_ == 0) origin_ = source_pts;
+    offsets_.push_back(source_pts - origin_);
+    return source_pts;
+}
+
+Duration LoopTimeline::pts() const { return origin_ + offsets_[index_]; }
+
+void LoopTimeline::advance() {
+    ++index_;
+    if (learned() && index_ >= length_) next_pass();
+}
+
+void LoopTimeline::end_of_clip() {
+    if (!learned()) length_ = index_;
+    if (learned()) next_pass();
+}
+
+void LoopTimeline::next_pass() {
+    origin_ += offsets_[length_ - 1] + interval_;
+    index_ = 0;
+}
+
+}
@@ -0,0 +1,151 @@
+#include "asciinema/luma.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define ASCIINEMA_X86 1
+#endif
+
+namespace asciinema {
+
+namespace {
+    // Same 15-bit weights and rounding as cv::COLOR_BGR2GRAY on 8-bit images.
+    constexpr int B_WEIGHT = 3735;
+    constexpr int G_WEIGHT = 19235;
+    constexpr int R_WEIGHT = 9798;
+    constexpr int LUMA_SHIFT = 15;
+    constexpr int LUMA_ROUND = 1 << (LUMA_SHIFT - 1);
+
+    // OpenCV's 8-bit vertical pass: each row drops 4 bits before its weight
+    // and 16 after, leaving 2 to round away.
+    inline int blend(int top, int bottom, int beta0, int beta1) {
+        return (((beta0 * (top >> 4)) >> 16) + ((beta1 * (bottom >> 4)) >> 16) + 2) >> 2;
+    }
+
+    inline int across(const uint8_t* row, const LinearTap& tap, int channel) {
+        return row[tap.first + channel] * tap.weight[0] + row[tap.second + channel] * tap.weight[1];
+    }
+
+    inline void linear_luma_tail(const uint8_t* top, const uint8_t* bottom, int channels, const LinearTap* columns,
+                                 int x, int width, int beta0, int beta1, uint8_t* luma) {
+        for (; x < width; ++x) {
+            const LinearTap& tap = columns[x];
+            const int b = blend(across(top, tap, 0), across(bottom, tap, 0), beta0, beta1);
+            if (channels == 1) {
+                luma[x] = static_cast<uint8_t>(b);
+                continue;
+            }
+            const int g = blend(across(top, tap, 1), across(bottom, tap, 1), beta0, beta1);
+            const int r = blend(across(top, tap, 2), across(bottom, tap, 2), beta0, beta1);
+            luma[x] = static_cast<uint8_t>((b * B_WEIGHT + g * G_WEIGHT + r * R_WEIGHT + LUMA_ROUND) >> LUMA_SHIFT);
+        }
+    }
+
+    // Samples [0, end) can read eight bytes from their first pixel without
+    // running off the row; the taps move right, so the last one decides.
+    inline int vector_end(const LinearTap* columns, int width, int row_bytes, int group) {
+        int end = width - width % group;
+        while (end > 0 && columns[end - 1].first + 8 > row_bytes) end -= group;
+        return end;
+    }
+}
+
+void linear_luma_scalar(const uint8_t* top, const uint8_t* bottom, int row_bytes, int channels,
+                        const LinearTap* columns, int width, int beta0, int beta1, uint8_t* luma) {
+    (void)row_bytes;
+    linear_luma_tail(top, bottom, channels, columns, 0, width, beta0, beta1, luma);
+}
+
+#ifdef ASCIINEMA_X86
+
+namespace {
+    // With a sample's two pixels from the top row in bytes 0-7 and from the
+    // bottom row in bytes 8-15, pairs each channel's two pixels as 16-bit
+    // lanes, so pmaddwd with the column weights yields B, G, R and 0.
+    // Indexed by whether pixels are four bytes apart rather than three.
+    constexpr int8_t Z = -1;
+    alignas(16) constexpr int8_t TOP_MASK[2][16] = {
+        {0, Z, 3, Z, 1, Z, 4, Z, 2, Z, 5, Z, Z, Z, Z, Z},
+        {0, Z, 4, Z, 1, Z, 5, Z, 2, Z, 6, Z, Z, Z, Z, Z},
+    };
+    alignas(16) constexpr int8_t BOTTOM_MASK[2][16] = {
+        {8, Z, 11, Z, 9, Z, 12, Z, 10, Z, 13, Z, Z, Z, Z, Z},
+        {8, Z, 12, Z, 9, Z, 13, Z, 10, Z, 14, Z, Z, Z, Z, Z},
+    };
+
+    // B, G, R and 0 of one sample, blended across and down. One eight-byte
+    // load per row covers both pixels: the second is the next one along,
+    // except at the edges where it has no weight.
+    __attribute__((target("sse4.1")))
+    inline __m128i linear_sample_sse41(const uint8_t* top, const uint8_t* bottom, const LinearTap& tap,
+                                       __m128i top_mask, __m128i bottom_mask, __m128i beta0, __m128i beta1) {
+        __m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + tap.first));
+        px = _mm_castpd_si128(_mm_loadh_pd(_mm_castsi128_pd(px), reinterpret_cast<const double*>(bottom + tap.first)));
+        const __m128i weight = _mm_set1_epi32((tap.weight[1] << 16) | tap.weight[0]);
+        __m128i t = _mm_srai_epi32(_mm_madd_epi16(_mm_shuffle_epi8(px, top_mask), weight), 4);
+        __m128i b = _mm_srai_epi32(_mm_madd_epi16(_mm_shuffle_epi8(px, bottom_mask), weight), 4);
+        __m128i sum = _mm_add_epi32(_mm_srai_epi32(_mm_mullo_epi32(t, beta0), 16),
+                                    _mm_srai_epi32(_mm_mullo_epi32(b, beta1), 16));
+        return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+    }
+
+    __attribute__((target("sse4.1")))
+    void linear_luma_sse41(const uint8_t* top, const uint8_t* bottom, int row_bytes, int channels,
+                           const LinearTap* columns, int width, int beta0, int beta1, uint8_t* luma) {
+        int x = 0;
+        if (channels != 1) {
+            const int layout = channels == 4 ? 1 : 0;
+            const __m128i top_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(TOP_MASK[layout]));
+            const __m128i bottom_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(BOTTOM_MASK[layout]));
+            const __m128i b0 = _mm_set1_epi32(beta0);
+            const __m128i b1 = _mm_set1_epi32(beta1);
+            const __m128i weights = _mm_setr_epi16(B_WEIGHT, G_WEIGHT, R_WEIGHT, 0, B_WEIGHT, G_WEIGHT, R_WEIGHT, 0);
+            const __m128i round = _mm_set1_epi32(LUMA_ROUND);
+
+            // Four samples per step: two per pmaddwd, then one hadd for all four sums.
+            for (const int end = vector_end(columns, width, row_bytes, 4); x < end; x += 4) {
+                __m128i s0 = linear_sample_sse41(top, bottom, columns[x], top_mask, bottom_mask, b0, b1);
+                __m128i s1 = linear_sample_sse41(top, bottom, columns[x + 1], top_mask, bottom_mask, b0, b1);
+                __m128i s2 = linear_sample_sse41(top, bottom, columns[x + 2], top_mask, bottom_mask, b0, b1);
+                __m128i s3 = linear_sample_sse41(top, bottom, columns[x + 3], top_mask, bottom_mask, b0, b1);
+                __m128i y = _mm_hadd_epi32(_mm_madd_epi16(_mm_packs_epi32(s0, s1), weights),
+                                           _mm_madd_epi16(_mm_packs_epi32(s2, s3), weights));
+                y = _mm_srai_epi32(_mm_add_epi32(y, round), LUMA_SHIFT);
+                y = _mm_packus_epi16(_mm_packus_epi32(y, y), y);
+                const int32_t packed = _mm_cvtsi128_si32(y);
+                std::memcpy(luma + x, &packed, sizeof(packed));
+            }
+        }
+        linear_luma_tail(top, bottom, channels, columns, x, width, beta0, beta1, luma);
+    }
+}
+
+#endif
+
+LumaRowFn select_luma_kernel() {
+#ifdef ASCIINEMA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) return linear_luma_sse41;
+#endif
+    return linear_luma_scalar;
+}
+
+const char* luma_kernel_name(LumaRowFn kernel) {
+#ifdef ASCIINEMA_X86
+    if (kernel == linear_luma_sse41) return "sse4.1";
+#endif
+    return kernel == linear_luma_scalar ? "scalar" : "unknown";
+}
+
+std::vector<LumaRowFn> supported_luma_kernels() {
+    std::vector<LumaRowFn> kernels;
+#ifdef ASCIINEMA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) kernels.push_back(linear_luma_sse41);
+#endif
+    kernels.push_back(linear_luma_scalar);
+    return kernels;
+}
+
+}
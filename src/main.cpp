@@ -1,6 +1,11 @@
+#include "asciinema/bench.h"
+#include "asciinema/exporter.h"
 #include "asciinema/pipeline.h"
 
+#include <algorithm>
 #include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -11,10 +16,27 @@ void signal_handler(int) {
 }
 
 void print_usage(const char* prog) {
-    std::cerr << "Usage: " << prog << " [OPTIONS] <video>\n\n"
+    std::cerr << "Usage: " << prog << " [OPTIONS] <video | frame file>\n\n"
               << "Options:\n"
               << "  -color    True color (24-bit) rendering\n"
+              << "  -palette N  256- or 16-color rendering (N = 256 or 16)\n"
+              << "  -dither   Ordered dithering with -palette\n"
+              << "  -halfblock  True color half blocks, two pixel rows per character\n"
               << "  -bp       Enable backpressure (default: frame dropping)\n"
+              << "  -latest   Drop stale frames instead of new ones when behind\n"
+              << "  -tol N    Merge true color runs within N levels (default: 0)\n"
+              << "  -workers N  Process frames on N threads (default: 1)\n"
+              << "  -bands N  Split large frames into row bands on N more threads\n"
+              << "  -slo MS   Adapt quality to keep p95 latency under MS\n"
+              << "  -loop-cache MB  Keep processed frames of a looping clip in memory\n"
+              << "  -static N  Skip frames within N levels per row of the last one (0: identical)\n"
+              << "  -size CxR  Character grid (default: fit the terminal)\n"
+              << "  -transcode FILE  Process the video once into a frame file and exit\n"
+              << "  -bench N  Render N frames headless as fast as possible, print JSON\n"
+              << "  -trace FILE  Write per-frame stage spans as Chrome trace JSON\n"
+              << "  -metrics-socket PATH  Serve Prometheus metrics on a Unix socket\n"
+              << "  -metrics-json FILE    Append a JSON metrics line per interval\n"
+              << "  -metrics-interval MS  Metrics export interval (default: 1000)\n"
               << "  -help     Show this message\n";
 }
 
@@ -22,14 +44,63 @@ int main(int argc, char* argv[]) {
     using namespace asciinema;
 
     bool use_color = false;
+    int palette = 0;
+    bool dither = false;
+    bool half_block = false;
     bool use_backpressure = false;
+    bool use_latest = false;
+    int color_tolerance = 0;
+    int workers = 1;
+    int band_threads = 0;
+    int latency_slo_ms = 0;
+    long loop_cache_mb = 0;
+    int static_threshold = -1;
+    long long bench_frames = 0;
+    Dimensions size{0, 0};
+    std::string transcode_path;
+    std::string trace_path;
+    ExporterConfig exporter_config;
     std::string video_path;
 
     for (int i = 1; i < argc; ++i) {
         if (std::strcmp(argv[i], "-color") == 0)
             use_color = true;
+        else if (std::strcmp(argv[i], "-palette") == 0 && i + 1 < argc)
+            palette = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-dither") == 0)
+            dither = true;
+        else if (std::strcmp(argv[i], "-halfblock") == 0)
+            half_block = true;
         else if (std::strcmp(argv[i], "-bp") == 0)
             use_backpressure = true;
+        else if (std::strcmp(argv[i], "-latest") == 0)
+            use_latest = true;
+        else if (std::strcmp(argv[i], "-tol") == 0 && i + 1 < argc)
+            color_tolerance = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-workers") == 0 && i + 1 < argc)
+            workers = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-bands") == 0 && i + 1 < argc)
+            band_threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-slo") == 0 && i + 1 < argc)
+            latency_slo_ms = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-loop-cache") == 0 && i + 1 < argc)
+            loop_cache_mb = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "-static") == 0 && i + 1 < argc)
+            static_threshold = std::max(std::atoi(argv[++i]), 0);
+        else if (std::strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &size.cols, &size.rows);
+        else if (std::strcmp(argv[i], "-transcode") == 0 && i + 1 < argc)
+            transcode_path = argv[++i];
+        else if (std::strcmp(argv[i], "-bench") == 0 && i + 1 < argc)
+            bench_frames = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (std::strcmp(argv[i], "-metrics-socket") == 0 && i + 1 < argc)
+            exporter_config.socket_path = argv[++i];
+        else if (std::strcmp(argv[i], "-metrics-json") == 0 && i + 1 < argc)
+            exporter_config.json_path = argv[++i];
+        else if (std::strcmp(argv[i], "-metrics-interval") == 0 && i + 1 < argc)
+            exporter_config.interval = std::chrono::milliseconds(std::max(std::atoi(argv[++i]), 10));
         else if (std::strcmp(argv[i], "-help") == 0 || std::strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return 0;
@@ -48,20 +119,85 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (palette != 0 && palette != 256 && palette != 16) {
+        std::cerr << "Error: -palette takes 256 or 16\n";
+        return 1;
+    }
+
+    if (workers > static_cast<int>(MAX_PROCESS_WORKERS)) {
+        std::cerr << "Error: -workers takes 1 to " << MAX_PROCESS_WORKERS << "\n";
+        return 1;
+    }
+
+    if (size.cols < 0 || size.rows < 0) {
+        std::cerr << "Error: Sizes must be positive\n";
+        return 1;
+    }
+
+    PipelineConfig config;
+    config.mode = palette == 256 ? RenderMode::Palette256
+                : palette == 16  ? RenderMode::Palette16
+                : half_block     ? RenderMode::HalfBlock
+                : use_color      ? RenderMode::TrueColor
+                                 : RenderMode::ASCII;
+    if (use_backpressure)
+        config.overflow = OverflowPolicy::Backpressure;
+    else if (use_latest)
+        config.overflow = OverflowPolicy::DropOldest;
+    config.color_tolerance = color_tolerance;
+    config.dither = dither;
+    config.process_workers = workers > 0 ? static_cast<size_t>(workers) : 1;
+    config.band_threads = static_cast<size_t>(std::max(band_threads, 0));
+    config.trace_path = trace_path;
+    config.latency_slo = std::chrono::milliseconds(std::max(latency_slo_ms, 0));
+    config.size = size;
+    config.loop_cache_bytes = static_cast<size_t>(std::max(loop_cache_mb, 0L)) << 20;
+    config.static_threshold = static_threshold;
+
+    if (!transcode_path.empty()) {
+        VideoDecoder decoder;
+        if (!decoder.open(video_path)) {
+            std::cerr << "Error: Could not open video file " << video_path << "\n";
+            return 1;
+        }
+        Dimensions dims = size.area() > 0 ? size : terminal_size();
+        uint64_t frames = transcode(decoder, transcode_path, dims, config.mode, color_tolerance, dither);
+        if (frames == 0) {
+            std::cerr << "Error: Could not write " << transcode_path << "\n";
+            return 1;
+        }
+        std::cerr << "Wrote " << frames << " frames at " << dims.cols << "x" << dims.rows
+                  << " to " << transcode_path << "\n";
+        return 0;
+    }
+
+    if (bench_frames > 0) {
+        BenchConfig bench;
+        bench.pipeline = config;
+        bench.frames = static_cast<uint64_t>(bench_frames);
+        bench.video_path = video_path;
+        if (size.area() > 0) bench.size = size;
+        return run_bench(bench, std::cout);
+    }
+
     Pipeline pipeline;
     g_pipeline = &pipeline;
 
     signal(SIGINT, signal_handler);
 
-    PipelineConfig config;
-    config.mode = use_color ? RenderMode::TrueColor : RenderMode::ASCII;
-    config.backpressure = use_backpressure;
-
     if (!pipeline.start(video_path, config)) {
         std::cerr << "Error: Could not start pipeline for " << video_path << "\n";
         return 1;
     }
 
+    MetricsExporter exporter(pipeline);
+    if (!exporter_config.socket_path.empty() || !exporter_config.json_path.empty()) {
+        if (!exporter.start(exporter_config)) {
+            std::cerr << "Error: Could not start metrics exporter\n";
+            return 1;
+        }
+    }
+
     while (pipeline.is_running()) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
@@ -0,0 +1,69 @@
+#include "asciinema/palette.h"
+
+#include <limits>
+#include <memory>
+
+namespace asciinema {
+
+namespace {
+    constexpr uint8_t CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+
+    // xterm's default basic colors.
+    constexpr uint32_t BASIC_COLORS[16] = {
+        0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+        0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff,
+    };
+
+    uint32_t xterm_color(int index) {
+        if (index < 16) return BASIC_COLORS[index];
+        if (index < 232) {
+            const int cube = index - 16;
+            return pack_rgb(CUBE_LEVELS[cube / 36], CUBE_LEVELS[cube / 6 % 6], CUBE_LEVELS[cube % 6]);
+        }
+        const uint8_t gray = static_cast<uint8_t>(8 + 10 * (index - 232));
+        return pack_rgb(gray, gray, gray);
+    }
+
+    // The same 2:4:3 weighting the true-color runs use.
+    int distance_sq(uint32_t a, int r, int g, int b) {
+        const int dr = static_cast<int>(a >> 16 & 0xff) - r;
+        const int dg = static_cast<int>(a >> 8 & 0xff) - g;
+        const int db = static_cast<int>(a & 0xff) - b;
+        return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+    }
+
+    // Each cell of the table stands for the center of its 8x8x8 block.
+    std::unique_ptr<PaletteLut> build_lut(int first, int count) {
+        auto lut = std::make_unique<PaletteLut>();
+        constexpr int STEPS = 1 << PaletteLut::BITS;
+        for (int r = 0; r < STEPS; ++r) {
+            for (int g = 0; g < STEPS; ++g) {
+                for (int b = 0; b < STEPS; ++b) {
+                    int best = first;
+                    int best_distance = std::numeric_limits<int>::max();
+                    for (int i = first; i < first + count; ++i) {
+                        const int d = distance_sq(xterm_color(i), r * 8 + 4, g * 8 + 4, b * 8 + 4);
+                        if (d < best_distance) {
+                            best = i;
+                            best_distance = d;
+                        }
+                    }
+                    lut->index[(r << (2 * PaletteLut::BITS)) | (g << PaletteLut::BITS) | b] =
+                        static_cast<uint8_t>(best);
+                }
+            }
+        }
+        return lut;
+    }
+}
+
+const PaletteLut& palette_lut(RenderMode mode) {
+    if (mode == RenderMode::Palette16) {
+        static const std::unique_ptr<PaletteLut> lut_16 = build_lut(0, 16);
+        return *lut_16;
+    }
+    static const std::unique_ptr<PaletteLut> lut_256 = build_lut(16, 240);
+    return *lut_256;
+}
+
+}
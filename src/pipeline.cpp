@@ -1,7 +1,10 @@
 #include "asciinema/pipeline.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <optional>
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -9,15 +12,33 @@
 namespace asciinema {
 
 namespace {
-    Dimensions get_terminal_size() {
-        struct winsize w;
-        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-        return {w.ws_col, static_cast<int>(w.ws_row - 2)};
+    constexpr Duration STATS_INTERVAL = std::chrono::milliseconds(100);
+    constexpr Duration QUALITY_INTERVAL = std::chrono::milliseconds(500);
+    constexpr Duration STILL_REFRESH = std::chrono::seconds(1);
+
+    // Stands in for a frame that shows the same picture as an earlier one.
+    ProcessedFrame repeat_marker(const RawFrame& raw) {
+        ProcessedFrame marker;
+        marker.id = raw.id;
+        marker.timestamp = raw.timestamp;
+        marker.pts = raw.pts;
+        marker.stages = raw.stages;
+        marker.clip_index = raw.clip_index;
+        marker.repeat = true;
+        marker.repeat_of = raw.repeat_of;
+        return marker;
     }
 }
 
+Dimensions terminal_size() {
+    struct winsize w;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) != 0 || w.ws_col == 0 || w.ws_row < 3)
+        return {80, 22};
+    return {w.ws_col, static_cast<int>(w.ws_row - 2)};
+}
+
 Pipeline::Pipeline(size_t decode_queue_size, size_t render_queue_size)
-    : decode_queue_(decode_queue_size)
+    : decode_queue_size_(decode_queue_size)
     , render_queue_(render_queue_size)
 {}
 
@@ -26,122 +47,573 @@ Pipeline::~Pipeline() {
 }
 
 bool Pipeline::start(const std::string& video_path, const PipelineConfig& config) {
-    if (running_) return false;
+    if (FrameFileReader::is_frame_file(video_path)) {
+        auto file = std::make_unique<FrameFileReader>();
+        if (!file->open(video_path)) return false;
+        return start(std::move(file), config);
+    }
+    auto decoder = std::make_unique<VideoDecoder>();
+    if (!decoder->open(video_path)) return false;
+    return start(std::move(decoder), config);
+}
+
+bool Pipeline::start(std::unique_ptr<FrameSource> source, const PipelineConfig& config) {
+    if (running_ || !source) return false;
+
+    source_ = std::move(source);
+    replay_.reset();
+    return launch(config, source_->frame_interval());
+}
+
+bool Pipeline::start(std::unique_ptr<FrameFileReader> file, const PipelineConfig& config) {
+    if (running_ || !file || !file->is_open()) return false;
+
+    replay_ = std::move(file);
+    source_.reset();
+    return launch(config, replay_->frame_interval());
+}
 
-    if (!decoder_.open(video_path)) return false;
+bool Pipeline::launch(const PipelineConfig& config, Duration frame_interval) {
+    mode_ = replay_ ? replay_->mode() : config.mode;
+    overflow_ = config.overflow;
+    output_ = config.output;
+    paced_ = config.paced;
+    max_frames_ = config.max_frames;
+    if (replay_)
+        dims_ = replay_->dimensions();
+    else
+        dims_ = config.size.area() > 0 ? config.size : terminal_size();
+
+    // Split the decode queue budget across workers so total buffering stays put.
+    // Each input ring keeps at least two slots, so many workers over a small
+    // budget buffer a little more rather than degenerating.
+    size_t worker_count = replay_ ? 1 : std::clamp<size_t>(config.process_workers, 1, MAX_PROCESS_WORKERS);
+    size_t input_size = std::max<size_t>(decode_queue_size_ / worker_count, 2);
+    size_t spare_size = render_queue_.capacity() * 2 / worker_count + 2;
+
+    workers_.clear();
+    bands_.reset(config.band_threads && !replay_ ? new TaskPool(config.band_threads) : nullptr);
+    for (size_t i = 0; i < worker_count; ++i) {
+        auto worker = std::make_unique<ProcessWorker>(input_size, spare_size);
+        worker->processor = FrameProcessor(dims_, mode_);
+        worker->processor.set_color_tolerance(config.color_tolerance);
+        worker->processor.set_dithering(config.dither);
+        worker->processor.set_band_pool(bands_.get());
+        workers_.push_back(std::move(worker));
+    }
+    // Enough images for every decode queue slot, one per worker, the one
+    // being decoded and the still detector's reference.
+    image_pool_.reset(replay_ ? 0 : decode_queue_capacity() + worker_count + 2);
+    metrics_.set_process_workers(worker_count);
+    clock_.reset();
+    clock_.set_tolerance(frame_interval);
+    recycle_worker_ = 0;
 
-    mode_ = config.mode;
-    backpressure_ = config.backpressure;
-    dims_ = get_terminal_size();
-    processor_ = FrameProcessor(dims_, mode_);
+    // With a latency SLO, decode stays at most half of it ahead of each
+    // frame's due time, so latency reflects how far behind the pipeline is
+    // rather than how deep the queues are.
+    quality_.reset(mode_, config.color_tolerance,
+                   paced_ && !replay_ ? config.latency_slo : Duration::zero());
+    quality_level_ = 0;
+    read_ahead_ = quality_.enabled() ? config.latency_slo / 2 : Duration::zero();
+    // The cache holds one rendition of the clip, so it stays off while
+    // quality adapts; a frame file needs none.
+    loop_cache_.reset(dims_, mode_, replay_ || quality_.enabled() ? 0 : config.loop_cache_bytes);
+    // Replayed frames are already cheap, and unchanged ones are empty deltas.
+    still_.reset(replay_ ? -1 : config.static_threshold, STILL_REFRESH, dims_.rows);
+    if (!config.trace_path.empty() && !trace_.open(config.trace_path, worker_count)) return false;
+    // Workers can be at most one input queue apart, so a smaller window would
+    // give up on frames that are merely slow.
+    reorder_.reset(worker_count, std::max(config.reorder_window, decode_queue_capacity() + worker_count));
     running_ = true;
 
-    decode_thread_ = std::thread(&Pipeline::decode_loop, this);
-    process_thread_ = std::thread(&Pipeline::process_loop, this);
+    if (replay_) {
+        workers_[0]->thread = std::thread(&Pipeline::replay_loop, this);
+    } else {
+        decode_thread_ = std::thread(&Pipeline::decode_loop, this);
+        for (size_t i = 0; i < worker_count; ++i)
+            workers_[i]->thread = std::thread(&Pipeline::process_loop, this, i);
+    }
     render_thread_ = std::thread(&Pipeline::render_loop, this);
 
     return true;
 }
 
+// Also reaps the threads after the render stage ended playback on its own
+// ('q' or max_frames), so it is safe to call more than once.
 void Pipeline::stop() {
-    if (!running_) return;
-
     running_ = false;
-    decode_queue_.stop();
+    for (auto& worker : workers_) worker->input.stop();
     render_queue_.stop();
 
     if (decode_thread_.joinable()) decode_thread_.join();
-    if (process_thread_.joinable()) process_thread_.join();
+    for (auto& worker : workers_)
+        if (worker->thread.joinable()) worker->thread.join();
     if (render_thread_.joinable()) render_thread_.join();
+    trace_.close();
+}
+
+size_t Pipeline::decode_queue_depth() const {
+    size_t depth = 0;
+    for (const auto& worker : workers_) depth += worker->input.size();
+    return depth;
 }
 
+size_t Pipeline::decode_queue_capacity() const {
+    size_t capacity = 0;
+    for (const auto& worker : workers_) capacity += worker->input.capacity();
+    return capacity;
+}
+
+// Frames that are not yet due wait for room; the overflow policy only
+// applies to frames that are already at or past their presentation slot.
+// Unpaced runs have no slots, so the policy applies from the first frame,
+// whether or not the clock has been anchored.
+template <typename T>
+bool Pipeline::hand_off(SpscQueue<T>& queue, T item) {
+    if (overflow_ == OverflowPolicy::Backpressure || is_early(item.pts)) {
+        queue.push(std::move(item));
+        return true;
+    }
+    if (overflow_ == OverflowPolicy::DropOldest) {
+        metrics_.frames_dropped += queue.push_latest(std::move(item));
+        return true;
+    }
+    if (queue.try_push(std::move(item))) return true;
+    metrics_.frames_dropped++;
+    return false;
+}
+
+// With the loop cache on, the pipeline numbers clip positions, FrameIds and
+// pts itself: once the clip has played through, positions the cache holds
+// never touch the source, and the source is moved to the first one it
+// does not.
 void Pipeline::decode_loop() {
-    double frame_delay = decoder_.frame_delay_ms();
-    auto next_frame_time = std::chrono::steady_clock::now();
+    size_t next_worker = 0;
+    const bool may_skip = overflow_ != OverflowPolicy::Backpressure;
+    const bool caching = loop_cache_.enabled();
+    LoopTimeline timeline(source_->frame_interval());
+    uint32_t source_at = 0;  // clip position the source grabs next
+    FrameId next_id = 0;
 
     while (running_) {
-        auto frame = decoder_.next_frame();
-        if (!frame) {
-            decoder_.reset();
+        auto grab_start = now();
+        const bool hit = caching && timeline.learned() && timeline.index() < loop_cache_.size();
+
+        if (!hit) {
+            if (caching && source_at != timeline.index()) source_at = align_source(timeline.index(), source_at);
+            if (!source_->grab()) {
+                source_->rewind();
+                source_at = 0;
+                if (caching) timeline.end_of_clip();
+                continue;
+            }
+            ++source_at;
+        }
+
+        ProcessWorker& worker = *workers_[next_worker];
+        next_worker = (next_worker + 1) % workers_.size();
+
+        uint32_t clip_index = timeline.index();
+        Duration pts = hit ? timeline.pts() : source_->grabbed_pts();
+        if (caching) {
+            if (!hit) pts = timeline.pts(pts);
+            timeline.advance();
+        }
+
+        if (read_ahead_ > Duration::zero()) {
+            if (!clock_.started()) clock_.anchor(now() + read_ahead_, pts);
+            // Time spent waiting here is pacing, not decode service time.
+            auto sleep_start = now();
+            std::this_thread::sleep_until(clock_.due(pts) - read_ahead_);
+            grab_start += now() - sleep_start;
+        }
+
+        // Shed load before the frame is retrieved and color-converted: a frame
+        // that has already missed its slot, or that is due and would be
+        // dropped at a full queue anyway, is only grabbed.
+        bool late = clock_.is_late(pts);
+        bool saturated = overflow_ == OverflowPolicy::DropNewest && !is_early(pts) &&
+                         worker.input.full();
+        if (may_skip && (late || saturated)) {
+            metrics_.frames_skipped++;
             continue;
         }
 
-        if (backpressure_) {
-            decode_queue_.push(std::move(*frame));
-            metrics_.frames_decoded++;
-            metrics_.decode_fps.tick();
+        std::optional<RawFrame> frame;
+        if (hit) {
+            frame.emplace();
+            frame->cached = true;
+            frame->timestamp = now();
+            metrics_.loop_cache_hits++;
         } else {
-            if (!decode_queue_.try_push(std::move(*frame))) {
-                metrics_.frames_dropped++;
-            } else {
-                metrics_.frames_decoded++;
-                metrics_.decode_fps.tick();
+            frame = source_->retrieve_into(image_pool_.acquire());
+            if (!frame) continue;
+            image_pool_.record(frame->image);
+            if (caching) metrics_.loop_cache_misses++;
+        }
+        if (caching) {
+            frame->id = next_id++;
+            frame->pts = pts;
+            frame->clip_index = clip_index;
+        }
+        // Cached frames are not compared, so the next decoded one starts
+        // afresh; so does each pass, or a cache that missed position 0
+        // could never start.
+        if (still_.enabled()) {
+            if (hit || (caching && clip_index == 0)) still_.forget();
+            if (!hit && still_.repeats(frame->image, frame->id, frame->pts)) {
+                frame->repeat = true;
+                frame->repeat_of = still_.reference();
+                frame->image.release();
             }
         }
+        frame->stages.grabbed = grab_start;
+        frame->stages.decoded = frame->timestamp;
+        metrics_.decode_time.record(frame->stages.decoded - grab_start);
 
-        next_frame_time += std::chrono::milliseconds(static_cast<int>(frame_delay));
-        std::this_thread::sleep_until(next_frame_time);
+        if (hand_off(worker.input, std::move(*frame))) {
+            metrics_.frames_decoded++;
+            metrics_.decode_fps.tick();
+        }
+    }
+}
+
+// Decode thread only: moves the source from clip position at to index,
+// rewinding or seeking where it can and grabbing through frames where it
+// cannot. Returns where the source ended up.
+uint32_t Pipeline::align_source(uint32_t index, uint32_t at) {
+    if (index < at) {
+        source_->rewind();
+        at = 0;
     }
+    if (index > at && source_->seek_frame(index)) return index;
+    while (at < index && source_->grab()) ++at;
+    return at;
 }
 
-void Pipeline::process_loop() {
+void Pipeline::process_loop(size_t index) {
+    ProcessWorker& worker = *workers_[index];
+    const bool may_drop = overflow_ != OverflowPolicy::Backpressure;
+    size_t quality_level = 0;
+    auto release = [this](ProcessedFrame&& ready) { release_frame(std::move(ready)); };
+
     while (running_) {
-        RawFrame raw = decode_queue_.pop();
+        RawFrame raw = worker.input.pop();
         if (!raw.valid()) continue;
+        raw.stages.process_dequeued = now();
+        raw.stages.worker = static_cast<uint32_t>(index);
+        metrics_.process_wait.record(raw.stages.process_dequeued - raw.stages.decoded, index);
 
-        ProcessedFrame processed = processor_.process(raw);
+        if (may_drop && clock_.is_late(raw.pts)) {
+            metrics_.frames_dropped++;
+            reorder_.skip(index, raw.id, release);
+            continue;
+        }
 
-        if (backpressure_) {
-            render_queue_.push(std::move(processed));
-            metrics_.frames_processed++;
-            metrics_.process_fps.tick();
+        while (auto spare = worker.spares.try_pop())
+            worker.processor.recycle(std::move(*spare));
+
+        size_t level = quality_level_.load(std::memory_order_acquire);
+        if (level != quality_level) {
+            const QualityLevel& quality = quality_.level(level);
+            worker.processor.set_render_mode(quality.mode);
+            worker.processor.set_cell_scale(quality.cell_scale);
+            worker.processor.set_color_tolerance(quality.color_tolerance);
+            quality_level = level;
+        }
+
+        uint64_t allocations = worker.processor.allocations();
+        ProcessedFrame processed;
+        if (raw.repeat) {
+            processed = repeat_marker(raw);
+        } else if (raw.cached) {
+            processed = worker.processor.spare_frame();
+            loop_cache_.load(raw, processed);
         } else {
-            if (!render_queue_.try_push(std::move(processed))) {
-                metrics_.frames_dropped++;
-            } else {
-                metrics_.frames_processed++;
-                metrics_.process_fps.tick();
-            }
+            processed = worker.processor.process(raw);
         }
+        processed.stages.processed = now();
+        metrics_.process_time.record(processed.stages.processed - processed.stages.process_dequeued, index);
+        metrics_.grid_allocations += worker.processor.allocations() - allocations;
+
+        metrics_.frames_dropped += reorder_.insert(index, std::move(processed), release);
+    }
+}
+
+// Reads frames in order and hands them straight to the render stage, so it
+// is render_queue_'s only producer. Late frames are still read, since each
+// one is a delta on the frame before it.
+void Pipeline::replay_loop() {
+    ProcessWorker& worker = *workers_[0];
+
+    while (running_) {
+        ProcessedFrame frame;
+        if (auto spare = worker.spares.try_pop()) frame = std::move(*spare);
+
+        auto read_start = now();
+        uint64_t allocations = replay_->allocations();
+        if (!replay_->next(frame)) {
+            replay_->rewind();
+            if (!replay_->next(frame)) break;
+        }
+        frame.timestamp = now();
+        frame.stages = {};
+        frame.stages.grabbed = read_start;
+        frame.stages.decoded = frame.timestamp;
+        frame.stages.process_dequeued = frame.timestamp;
+        frame.stages.processed = frame.timestamp;
+        metrics_.decode_time.record(frame.timestamp - read_start);
+        metrics_.grid_allocations += replay_->allocations() - allocations;
+        metrics_.frames_decoded++;
+        metrics_.decode_fps.tick();
+
+        release_frame(std::move(frame));
     }
 }
 
+// Called in FrameId order by the reorder buffer, which also makes the
+// workers take turns as render_queue_'s single producer.
+void Pipeline::release_frame(ProcessedFrame&& frame) {
+    if (hand_off(render_queue_, std::move(frame))) {
+        metrics_.frames_processed++;
+        metrics_.process_fps.tick();
+    }
+}
+
+// Render thread only: feeds the last window's metrics to the quality
+// controller and publishes its level to the workers.
+void Pipeline::adapt_quality() {
+    double fill = static_cast<double>(decode_queue_depth()) / static_cast<double>(decode_queue_capacity());
+    if (!quality_.update(metrics_, workers_.size(), source_->frame_interval(), fill)) return;
+
+    quality_level_.store(quality_.level_index(), std::memory_order_release);
+    metrics_.quality_level = quality_.level_index();
+    metrics_.quality_changes++;
+}
+
+// Render thread only: returns spent frames to the workers round-robin.
+void Pipeline::recycle_frame(ProcessedFrame&& frame) {
+    workers_[recycle_worker_]->spares.try_push(std::move(frame));
+    recycle_worker_ = (recycle_worker_ + 1) % workers_.size();
+}
+
 void Pipeline::render_loop() {
-    if (mode_ == RenderMode::TrueColor) {
-        std::cout << "\033[?25l\033[?1049h";
+    const bool to_terminal = output_ == OutputTarget::Terminal;
+
+    TtyWriter tty(metrics_);
+    if (to_terminal && is_color(mode_)) {
+        std::cout << std::flush;
+        if (tty.open(STDOUT_FILENO)) tty.write_all("\033[?25l\033[?1049h");
     }
 
     TerminalRenderer* renderer = nullptr;
-    if (mode_ == RenderMode::ASCII) {
+    if (to_terminal && mode_ == RenderMode::ASCII) {
         renderer = new TerminalRenderer();
     }
 
-    const char* strategy = backpressure_ ? "BP" : "DROP";
+    const char* strategy = overflow_ == OverflowPolicy::Backpressure ? "BP"
+                         : overflow_ == OverflowPolicy::DropOldest   ? "LATEST"
+                                                                     : "DROP";
+
+    DeltaTracker screen;
+    std::vector<CellRun> runs;
+    std::string delta;
+    std::string stats;
+    TimePoint stats_at{};
+    TimePoint quality_at = now();
+    std::optional<FrameId> on_screen;  // frame whose picture the screen shows
+    ProcessedFrame held;               // last frame dropped as late, while repeats of it may still be due
+
+    auto put_stats = [&](std::string& out) {
+        out += "\033[";
+        out += std::to_string(dims_.rows + 1);
+        out += ";1H\033[7m ";
+        out += stats;
+        out += " \033[0m";
+    };
 
     while (running_) {
         ProcessedFrame frame = render_queue_.pop();
         if (!frame.valid()) continue;
+        frame.stages.render_dequeued = now();
+        metrics_.render_wait.record(frame.stages.render_dequeued - frame.stages.processed);
+
+        // Before pacing, so frames dropped as late still fill the cache.
+        if (loop_cache_.enabled() && loop_cache_.insert(frame)) metrics_.loop_cache_frames = loop_cache_.size();
+
+        // Present against the playback clock: late frames are dropped (or,
+        // under backpressure, re-anchor the clock so playback slows instead),
+        // early ones wait until they are due.
+        if (paced_) {
+            if (!clock_.started()) clock_.anchor(now(), frame.pts);
+            if (clock_.is_late(frame.pts)) {
+                if (overflow_ != OverflowPolicy::Backpressure) {
+                    metrics_.frames_dropped++;
+                    if (trace_.is_open()) trace_.record(frame.id, frame.stages);
+                    if (!frame.repeat) {
+                        if (held.valid()) recycle_frame(std::move(held));
+                        held = std::move(frame);
+                    }
+                    continue;
+                }
+                clock_.anchor(now(), frame.pts);
+            }
+        }
+
+        // A repeat only stands for the picture it repeats. If that frame was
+        // dropped here as late, it is shown in the repeat's slot instead; if
+        // it was lost upstream, the repeat is dropped too.
+        if (frame.repeat && on_screen != frame.repeat_of) {
+            if (!held.valid() || held.id != frame.repeat_of) {
+                metrics_.frames_dropped++;
+                if (trace_.is_open()) trace_.record(frame.id, frame.stages);
+                continue;
+            }
+            ProcessedFrame marker = std::move(frame);
+            frame = std::move(held);
+            held = ProcessedFrame();
+            frame.id = marker.id;
+            frame.timestamp = marker.timestamp;
+            frame.pts = marker.pts;
+            frame.stages = marker.stages;
+            frame.clip_index = marker.clip_index;
+        }
+
+        if (paced_) {
+            TimePoint due = clock_.due(frame.pts);
+            // Finish any frame the terminal could not take at once first.
+            if (tty.is_open()) tty.flush_until(due);
+            sleep_until_precise(due);
+            TimePoint presented = now();
+            metrics_.jitter.record(presented > due ? presented - due : due - presented);
+        }
 
         metrics_.frames_rendered++;
         metrics_.render_fps.tick();
-        metrics_.latency.record(frame.latency_ms());
-
-        std::string stats = metrics_.format();
-        stats += " | Q:" + std::to_string(decode_queue_.size()) + "/" + 
-                 std::to_string(decode_queue_.capacity());
-        stats += " | ";
-        stats += strategy;
-
-        if (mode_ == RenderMode::TrueColor) {
-            std::cout << "\033[H" << frame.char_grid << "\033[0m";
-            std::cout << "\033[" << (dims_.rows + 1) << ";1H\033[7m " 
-                      << stats << " \033[0m" << std::flush;
+
+        // Merging the metric shards is the reader's cost; refresh the line
+        // at a readable rate rather than per frame.
+        bool stats_changed = false;
+        if (to_terminal && now() - stats_at >= STATS_INTERVAL) {
+            stats_at = now();
+            stats_changed = true;
+            stats = metrics_.format();
+            stats += " | Q:" + std::to_string(decode_queue_depth()) + "/" + 
+                     std::to_string(decode_queue_capacity());
+            stats += " | ";
+            stats += strategy;
+            if (quality_.enabled())
+                stats += " | Lvl " + std::to_string(quality_.level_index()) + "/" +
+                         std::to_string(quality_.levels() - 1);
+            if (loop_cache_.enabled()) {
+                uint64_t hits = metrics_.loop_cache_hits.load();
+                uint64_t served = hits + metrics_.loop_cache_misses.load();
+                stats += " | Cache " + std::to_string(served ? hits * 100 / served : 0) + "%";
+            }
+            if (still_.enabled()) {
+                uint64_t rendered = metrics_.frames_rendered.load();
+                uint64_t repeated = metrics_.frames_repeated.load();
+                stats += " | Static " + std::to_string(rendered ? repeated * 100 / rendered : 0) + "%";
+            }
+            if (tty.is_open()) {
+                char writes[64];
+                snprintf(writes, sizeof(writes), " | Wr %.2f/f %.2fms", metrics_.writes_per_frame(),
+                         metrics_.tty_write_time.snapshot().p95());
+                stats += writes;
+            }
+        }
+
+        frame.stages.draw_start = now();
+        metrics_.pace_wait.record(frame.stages.draw_start - frame.stages.render_dequeued);
+        size_t bytes = 0;
+        bool shown = true;  // false when the terminal was still busy with the last frame
+
+        if (frame.repeat) {
+            // The picture is already up; only a refreshed stats line goes out.
+            metrics_.frames_repeated++;
+            if (stats_changed && tty.is_open()) {
+                put_stats(tty.begin_frame());
+                tty.submit();
+            } else if (stats_changed && renderer) {
+                renderer->render_stats(stats);
+                renderer->refresh();
+            }
+        } else if (is_color(mode_)) {
+            // Cells become escape sequences here, straight into the tty's
+            // buffer; without a terminal they are still encoded and counted.
+            std::string& out = tty.is_open() ? tty.begin_frame() : delta;
+            if (!tty.is_open()) delta.clear();
+            const size_t start = out.size();
+
+            bool partial = screen.diff(frame, runs);
+            // The quality controller may hand this session ASCII frames.
+            if (partial) {
+                if (is_color(frame.cells.mode))
+                    encode_color_runs(frame.cells, runs, out);
+                else
+                    encode_ascii_runs(frame.cells, runs, out);
+                bytes = out.size() - start;
+                partial = bytes < encoded_grid_size(frame.cells);
+                if (!partial) out.resize(start);
+            }
+            if (!partial) {
+                out += "\033[H";
+                encode_grid(frame.cells, out);
+                bytes = out.size() - start - 3;
+                out += "\033[0m";
+            }
+            if (tty.is_open()) {
+                put_stats(out);
+                shown = tty.submit();
+                if (!shown) bytes = 0;
+            }
         } else {
-            renderer->clear();
-            renderer->render(frame, mode_);
-            renderer->render_stats(stats);
-            renderer->refresh();
+            bool partial = screen.diff(frame, runs);
+            if (partial) {
+                for (const CellRun& run : runs) bytes += static_cast<size_t>(run.length);
+            } else {
+                bytes = encoded_grid_size(frame.cells);
+            }
+            if (renderer) {
+                if (partial)
+                    renderer->render_runs(frame, runs);
+                else
+                    renderer->render(frame);
+                renderer->render_stats(stats);
+                renderer->refresh();
+            }
+        }
+
+        if (!frame.repeat && shown) {
+            screen.present(frame);
+            on_screen = frame.id;
+            if (held.valid()) recycle_frame(std::move(held));
+        }
+        frame.stages.written = now();
+        metrics_.bytes_rendered += bytes;
+        metrics_.draw_time.record(frame.stages.written - frame.stages.draw_start);
+        metrics_.latency.record(frame.stages.written - frame.stages.decoded);
+        if (trace_.is_open()) trace_.record(frame.id, frame.stages);
+        if (!frame.repeat && !shown) {
+            // Like a late frame: a repeat of it may get it out yet.
+            if (held.valid()) recycle_frame(std::move(held));
+            held = std::move(frame);
+        } else if (!frame.repeat) {
+            recycle_frame(std::move(frame));
+        }
+
+        if (quality_.enabled() && now() - quality_at >= QUALITY_INTERVAL) {
+            quality_at = now();
+            adapt_quality();
+        }
+
+        if (max_frames_ && metrics_.frames_rendered >= max_frames_) {
+            running_ = false;
+            break;
+        }
 
+        if (renderer) {
             int ch = getch();
             if (ch == 'q' || ch == 'Q') {
                 running_ = false;
@@ -150,8 +622,9 @@ void Pipeline::render_loop() {
         }
     }
 
-    if (mode_ == RenderMode::TrueColor) {
-        std::cout << "\033[?1049l\033[?25h" << std::flush;
+    if (tty.is_open()) {
+        tty.write_all("\033[?1049l\033[?25h");
+        tty.close();
     }
 
     delete renderer;
@@ -0,0 +1,62 @@
+#include "asciinema/pool.h"
+
+namespace asciinema {
+
+namespace {
+    // References held to image's memory, image itself included. OpenCV
+    // updates the count atomically; the acquire load makes a release on
+    // another thread happen before the memory is decoded into again.
+    int references(const cv::Mat& image) {
+        return image.u ? __atomic_load_n(&image.u->refcount, __ATOMIC_ACQUIRE) : 0;
+    }
+}
+
+void ImagePool::reset(size_t capacity) {
+    images_.clear();
+    images_.reserve(capacity);
+    capacity_ = capacity;
+    next_ = 0;
+    lent_ = nullptr;
+    metrics_.image_pool_outstanding = 0;
+}
+
+cv::Mat ImagePool::acquire() {
+    lent_ = nullptr;
+    const size_t count = images_.size();
+    for (size_t i = 0; i < count; ++i) {
+        const size_t slot = (next_ + i) % count;
+        if (references(images_[slot]) != 1) continue;
+        next_ = (slot + 1) % count;
+        lent_ = images_[slot].data;
+        return images_[slot];
+    }
+    return cv::Mat();
+}
+
+void ImagePool::record(const cv::Mat& image) {
+    if (!enabled() || image.empty()) return;
+
+    if (lent_ && image.data == lent_) {
+        metrics_.image_pool_hits++;
+    } else if (references(image) == 1) {
+        metrics_.image_pool_misses++;
+        // A full pool swaps out a free image instead, which retires images
+        // of a size the source no longer decodes.
+        if (images_.size() < capacity_) {
+            images_.push_back(image);
+        } else {
+            for (cv::Mat& owned : images_) {
+                if (references(owned) != 1) continue;
+                owned = image;
+                break;
+            }
+        }
+    }
+    lent_ = nullptr;
+
+    uint64_t outstanding = 0;
+    for (const cv::Mat& owned : images_) outstanding += references(owned) > 1;
+    metrics_.image_pool_outstanding = outstanding;
+}
+
+}
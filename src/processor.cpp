@@ -1,60 +1,368 @@
 #include "asciinema/processor.h"
 
 #include <opencv2/imgproc.hpp>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
 
 namespace asciinema {
 
+namespace {
+    constexpr size_t MAX_SPARE_FRAMES = 16;
+
+    // cv::resize keeps INTER_LINEAR weights for 8-bit images as 11-bit fixed point.
+    constexpr int RESIZE_WEIGHT_SCALE = 1 << 11;
+
+    // Smaller grids are not worth waking the band threads for.
+    constexpr int MIN_BANDED_CELLS = 16384;
+    constexpr int MIN_BAND_ROWS = 4;
+    // More bands than threads, so threads that finish early steal the rest.
+    constexpr size_t BANDS_PER_THREAD = 2;
+
+    // Weighted RGB distance (2:4:3), scaled so a tolerance of t allows roughly
+    // t levels of difference per channel.
+    template <int Channels>
+    inline int color_distance_sq(const uint8_t* a, const uint8_t* b) {
+        if constexpr (Channels == 1) {
+            int d = a[0] - b[0];
+            return 9 * d * d;
+        } else {
+            int dr = a[2] - b[2];
+            int dg = a[1] - b[1];
+            int db = a[0] - b[0];
+            return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+        }
+    }
+
+    // Gray, BGR or BGRA pixel as 0x00RRGGBB.
+    template <int Channels>
+    inline uint32_t pixel_rgb(const uint8_t* px) {
+        if constexpr (Channels == 1)
+            return pack_rgb(px[0], px[0], px[0]);
+        else
+            return pack_rgb(px[2], px[1], px[0]);
+    }
+
+    // Full RGB color for one row of cells from a row of pixels read in
+    // place, each pixel covering scale cells. Cells within tolerance of the
+    // cell that started their run take on its color; with no tolerance that
+    // is every pixel's own color.
+    template <int Channels, bool Exact, bool Scaled>
+    void encode_color_row(const uint8_t* px, int cols, int scale, int max_distance_sq, uint32_t* cell) {
+        if constexpr (Exact && !Scaled) {
+            for (int x = 0; x < cols; ++x, px += Channels) cell[x] = pixel_rgb<Channels>(px);
+        } else {
+            const uint8_t* run = px;
+            uint32_t run_rgb = pixel_rgb<Channels>(px);
+            for (int x = 0; x < cols; px += Channels) {
+                if (Exact || color_distance_sq<Channels>(px, run) > max_distance_sq) {
+                    run = px;
+                    run_rgb = pixel_rgb<Channels>(px);
+                }
+                for (int end = std::min(x + scale, cols); x < end; ++x) *cell++ = run_rgb;
+            }
+        }
+    }
+
+    // Where cv::resize's INTER_LINEAR samples output index d, with the same
+    // double-then-float steps: the source index and the weights of it and
+    // the next one.
+    inline int linear_position(int d, double scale, int weight[2]) {
+        float f = static_cast<float>((d + 0.5) * scale - 0.5);
+        const int s = static_cast<int>(std::floor(f));
+        f -= static_cast<float>(s);
+        weight[0] = static_cast<int>(std::lrint((1.f - f) * RESIZE_WEIGHT_SCALE));
+        weight[1] = static_cast<int>(std::lrint(f * RESIZE_WEIGHT_SCALE));
+        return s;
+    }
+}
+
 FrameProcessor::FrameProcessor(Dimensions dims, RenderMode mode)
-    : dims_(dims), mode_(mode) {}
+    : dims_(dims), mode_(mode), linear_luma_(select_luma_kernel()) {
+    spare_.reserve(MAX_SPARE_FRAMES);
+    select_kernel(kernel_channels_);
+}
+
+void FrameProcessor::set_dimensions(Dimensions dims) {
+    dims_ = dims;
+    column_taps_.clear();
+}
 
-void FrameProcessor::set_dimensions(Dimensions dims) { dims_ = dims; }
 Dimensions FrameProcessor::dimensions() const { return dims_; }
 
-void FrameProcessor::set_render_mode(RenderMode mode) { mode_ = mode; }
+void FrameProcessor::set_render_mode(RenderMode mode) {
+    mode_ = mode;
+    select_kernel(kernel_channels_);
+}
+
 RenderMode FrameProcessor::render_mode() const { return mode_; }
 
+void FrameProcessor::set_color_tolerance(int tolerance) {
+    color_tolerance_ = tolerance > 0 ? tolerance : 0;
+    select_kernel(kernel_channels_);
+}
+
+int FrameProcessor::color_tolerance() const { return color_tolerance_; }
+
+void FrameProcessor::set_dithering(bool dither) {
+    dither_ = dither;
+    select_kernel(kernel_channels_);
+}
+
+bool FrameProcessor::dithering() const { return dither_; }
+
+void FrameProcessor::set_cell_scale(int scale) {
+    cell_scale_ = scale > 1 ? scale : 1;
+    column_taps_.clear();
+    select_kernel(kernel_channels_);
+}
+
+int FrameProcessor::cell_scale() const { return cell_scale_; }
+
+// Everything that varies per pixel is a template parameter, so the inner
+// loops carry no mode, layout or option checks. Channel counts other than
+// gray and BGRA are read as BGR.
+void FrameProcessor::select_kernel(int channels) {
+    if (channels != kernel_channels_) column_taps_.clear();  // byte offsets depend on the layout
+    kernel_channels_ = channels;
+    palette_ = mode_ == RenderMode::Palette256 || mode_ == RenderMode::Palette16 ? &palette_lut(mode_) : nullptr;
+    if (channels == 1)
+        encode_ = kernel_for<1>();
+    else if (channels == 4)
+        encode_ = kernel_for<4>();
+    else
+        encode_ = kernel_for<3>();
+}
+
+template <int Channels>
+FrameProcessor::EncodeFn FrameProcessor::kernel_for() const {
+    const bool scaled = cell_scale_ > 1;
+    if (mode_ == RenderMode::Palette256 || mode_ == RenderMode::Palette16) {
+        if (dither_)
+            return scaled ? &FrameProcessor::encode_palette<Channels, true, true>
+                          : &FrameProcessor::encode_palette<Channels, true, false>;
+        return scaled ? &FrameProcessor::encode_palette<Channels, false, true>
+                      : &FrameProcessor::encode_palette<Channels, false, false>;
+    }
+    if (mode_ == RenderMode::TrueColor || mode_ == RenderMode::HalfBlock) {
+        // [half blocks][exact][scaled]
+        constexpr EncodeFn COLOR_KERNELS[2][2][2] = {
+            {{&FrameProcessor::encode_truecolor<Channels, false, false, false>,
+              &FrameProcessor::encode_truecolor<Channels, false, true, false>},
+             {&FrameProcessor::encode_truecolor<Channels, true, false, false>,
+              &FrameProcessor::encode_truecolor<Channels, true, true, false>}},
+            {{&FrameProcessor::encode_truecolor<Channels, false, false, true>,
+              &FrameProcessor::encode_truecolor<Channels, false, true, true>},
+             {&FrameProcessor::encode_truecolor<Channels, true, false, true>,
+              &FrameProcessor::encode_truecolor<Channels, true, true, true>}},
+        };
+        return COLOR_KERNELS[mode_ == RenderMode::HalfBlock][color_tolerance_ == 0][scaled];
+    }
+    return scaled ? &FrameProcessor::encode_ascii<Channels, true> : &FrameProcessor::encode_ascii<Channels, false>;
+}
+
+void FrameProcessor::recycle(ProcessedFrame&& frame) {
+    if (spare_.size() < MAX_SPARE_FRAMES) spare_.push_back(std::move(frame));
+}
+
+uint64_t FrameProcessor::allocations() const { return allocations_; }
+
+ProcessedFrame FrameProcessor::spare_frame() {
+    ProcessedFrame frame;
+    if (!spare_.empty()) {
+        frame = std::move(spare_.back());
+        spare_.pop_back();
+    }
+
+    if (frame.cells.reset(dims_, mode_)) ++allocations_;
+    return frame;
+}
+
+// Row bands are independent: each covers whole sampled rows, reads its
+// own part of the image and writes its own slice of the cell arrays.
+size_t FrameProcessor::band_count(int sampled_rows) const {
+    if (!bands_ || dims_.area() < MIN_BANDED_CELLS) return 1;
+    const size_t most = static_cast<size_t>(std::max(sampled_rows / MIN_BAND_ROWS, 1));
+    return std::min(bands_->concurrency() * BANDS_PER_THREAD, most);
+}
+
 ProcessedFrame FrameProcessor::process(const RawFrame& frame) {
-    cv::resize(frame.image, resized_, cv::Size(dims_.cols, dims_.rows));
+    ProcessedFrame result = spare_frame();
 
-    std::ostringstream oss;
+    const int channels = frame.image.channels();
+    if (channels != kernel_channels_) select_kernel(channels);
 
-    if (mode_ == RenderMode::TrueColor) {
-        // Full RGB color output
-        cv::Mat rgb;
-        if (resized_.channels() == 4)
-            cv::cvtColor(resized_, rgb, cv::COLOR_BGRA2BGR);
-        else
-            rgb = resized_;
-
-        for (int y = 0; y < rgb.rows; ++y) {
-            const uint8_t* row = rgb.ptr<uint8_t>(y);
-            for (int x = 0; x < rgb.cols; ++x) {
-                int b = row[x * 3];
-                int g = row[x * 3 + 1];
-                int r = row[x * 3 + 2];
-                oss << "\033[48;2;" << r << ";" << g << ";" << b << "m \033[0m";
+    const int scale = cell_scale_;
+    const int sampled_rows = (dims_.rows + scale - 1) / scale;
+    if (is_color(mode_))
+        cv::resize(frame.image, resized_,
+                   cv::Size((dims_.cols + scale - 1) / scale, sampled_rows * rows_per_cell(mode_)));
+    else if (column_taps_.empty() || frame.image.cols != taps_width_ || frame.image.rows != taps_height_)
+        update_linear_taps(frame.image.cols, frame.image.rows);
+
+    const size_t bands = band_count(sampled_rows);
+    if (luma_rows_.size() < bands) luma_rows_.resize(bands);
+    auto encode_band = [&](size_t band) {
+        const int sy0 = static_cast<int>(band * sampled_rows / bands);
+        const int sy1 = static_cast<int>((band + 1) * sampled_rows / bands);
+        (this->*encode_)(frame.image, sy0, sy1, band, result.cells);
+    };
+    if (bands > 1)
+        bands_->run(bands, encode_band);
+    else
+        encode_band(0);
+
+    result.id = frame.id;
+    result.timestamp = frame.timestamp;
+    result.stages = frame.stages;
+    result.pts = frame.pts;
+    result.clip_index = frame.clip_index;
+    return result;
+}
+
+// Sampled rows [sy0, sy1) of resized_, one per block of scale cell rows;
+// with half blocks each takes two rows of resized_, top and bottom.
+template <int Channels, bool Exact, bool Scaled, bool Halves>
+void FrameProcessor::encode_truecolor(const cv::Mat&, int sy0, int sy1, size_t, CellGrid& cells) {
+    const int scale = Scaled ? cell_scale_ : 1;
+    const size_t cols = static_cast<size_t>(dims_.cols);
+    const int max_distance_sq = 9 * color_tolerance_ * color_tolerance_;
+
+    for (int sy = sy0, y = sy0 * scale; sy < sy1; ++sy) {
+        uint32_t* fg = Halves ? cells.fg.data() + y * cols : nullptr;
+        uint32_t* bg = cells.bg.data() + y * cols;
+        if constexpr (Halves) {
+            encode_color_row<Channels, Exact, Scaled>(resized_.ptr<uint8_t>(2 * sy), dims_.cols, scale,
+                                                      max_distance_sq, fg);
+            encode_color_row<Channels, Exact, Scaled>(resized_.ptr<uint8_t>(2 * sy + 1), dims_.cols, scale,
+                                                      max_distance_sq, bg);
+        } else {
+            encode_color_row<Channels, Exact, Scaled>(resized_.ptr<uint8_t>(sy), dims_.cols, scale, max_distance_sq,
+                                                      bg);
+        }
+
+        // The rest of the block's rows are the same.
+        for (++y; y < dims_.rows && y % scale != 0; ++y) {
+            std::copy(bg, bg + cols, cells.bg.data() + y * cols);
+            if constexpr (Halves) std::copy(fg, fg + cols, cells.fg.data() + y * cols);
+        }
+    }
+}
+
+// Palette indices for sampled rows [sy0, sy1) of resized_. Quantizing
+// already merges similar colors, so the tolerance does not apply.
+template <int Channels, bool Dither, bool Scaled>
+void FrameProcessor::encode_palette(const cv::Mat&, int sy0, int sy1, size_t, CellGrid& cells) {
+    const int scale = Scaled ? cell_scale_ : 1;
+    const PaletteLut& lut = *palette_;
+    const DitherMatrix& dither = mode_ == RenderMode::Palette16 ? DITHER_16 : DITHER_256;
+
+    uint32_t* cell = cells.bg.data() + static_cast<size_t>(sy0) * scale * dims_.cols;
+    for (int sy = sy0, y = sy0 * scale; sy < sy1; ++sy) {
+        uint32_t* row_cells = cell;
+        const uint8_t* px = resized_.ptr<uint8_t>(sy);
+        const int8_t* offsets = dither.offset[sy & 3];
+        for (int sx = 0, x = 0; x < dims_.cols; ++sx, px += Channels) {
+            int r = px[Channels == 1 ? 0 : 2];
+            int g = px[Channels == 1 ? 0 : 1];
+            int b = px[0];
+            if constexpr (Dither) {
+                const int offset = offsets[sx & 3];
+                r = std::clamp(r + offset, 0, 255);
+                g = std::clamp(g + offset, 0, 255);
+                b = std::clamp(b + offset, 0, 255);
             }
-            oss << '\n';
-        }
-    } else {
-        // ASCII grayscale
-        if (resized_.channels() == 3)
-            cv::cvtColor(resized_, grayscale_, cv::COLOR_BGR2GRAY);
-        else if (resized_.channels() == 4)
-            cv::cvtColor(resized_, grayscale_, cv::COLOR_BGRA2GRAY);
-        else
-            grayscale_ = resized_;
+            const uint32_t index = lut.lookup(static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b));
+            for (int end = std::min(x + scale, dims_.cols); x < end; ++x) *cell++ = index;
+        }
+
+        for (++y; y < dims_.rows && y % scale != 0; ++y)
+            cell = std::copy(row_cells, row_cells + dims_.cols, cell);
+    }
+}
 
-        for (int y = 0; y < grayscale_.rows; ++y) {
-            const uint8_t* row = grayscale_.ptr<uint8_t>(y);
-            for (int x = 0; x < grayscale_.cols; ++x)
-                oss << pixel_to_char(row[x]);
-            oss << '\n';
+// The sampled grid mapped onto the image as cv::resize does for
+// INTER_LINEAR. Columns past either edge clamp to it with all the weight
+// on one pixel; rows clamp their indices but keep their weights.
+//
+// An exact halving in both directions is the exception: cv::resize runs
+// INTER_AREA instead, the mean of each 2x2 block rounded to nearest. Equal
+// weights on both pixels of a pair give the same bytes, as the blend then
+// adds up the four pixels exactly and rounds away two bits.
+void FrameProcessor::update_linear_taps(int width, int height) {
+    const int channels = kernel_channels_ == 1 || kernel_channels_ == 4 ? kernel_channels_ : 3;
+    const int sampled_cols = (dims_.cols + cell_scale_ - 1) / cell_scale_;
+    const int sampled_rows = (dims_.rows + cell_scale_ - 1) / cell_scale_;
+    const double scale_x = 1. / (static_cast<double>(sampled_cols) / width);
+    const double scale_y = 1. / (static_cast<double>(sampled_rows) / height);
+    const bool halving = width == 2 * sampled_cols && height == 2 * sampled_rows;
+    constexpr int HALF = RESIZE_WEIGHT_SCALE / 2;
+
+    column_taps_.resize(static_cast<size_t>(sampled_cols));
+    for (int sx = 0; sx < sampled_cols; ++sx) {
+        LinearTap& tap = column_taps_[sx];
+        if (halving) {
+            tap = {2 * sx * channels, (2 * sx + 1) * channels, {HALF, HALF}};
+            continue;
+        }
+        int x = linear_position(sx, scale_x, tap.weight);
+        if (x < 0 || x >= width - 1) {
+            x = std::clamp(x, 0, width - 1);
+            tap.weight[0] = RESIZE_WEIGHT_SCALE;
+            tap.weight[1] = 0;
         }
+        tap.first = x * channels;
+        tap.second = std::min(x + 1, width - 1) * channels;
     }
 
-    return ProcessedFrame(frame.id, frame.timestamp, oss.str(), dims_);
+    row_taps_.resize(static_cast<size_t>(sampled_rows));
+    for (int sy = 0; sy < sampled_rows; ++sy) {
+        LinearTap& tap = row_taps_[sy];
+        if (halving) {
+            tap = {2 * sy, 2 * sy + 1, {HALF, HALF}};
+            continue;
+        }
+        const int y = linear_position(sy, scale_y, tap.weight);
+        tap.first = std::clamp(y, 0, height - 1);
+        tap.second = std::clamp(y + 1, 0, height - 1);
+    }
+    taps_width_ = width;
+    taps_height_ = height;
 }
 
-} 
+// Single pass from the decoded image to glyphs that matches cv::resize
+// (INTER_LINEAR, or INTER_AREA where it switches) to the sampled grid, cv::cvtColor to gray and a ramp
+// lookup byte for byte: the dispatched SIMD kernel blends each sample's
+// four source pixels straight into luma, and the ramp table turns that
+// into glyphs.
+template <int Channels, bool Scaled>
+void FrameProcessor::encode_ascii(const cv::Mat& image, int sy0, int sy1, size_t band, CellGrid& cells) {
+    const int scale = Scaled ? cell_scale_ : 1;
+    const int sampled_cols = static_cast<int>(column_taps_.size());
+    const int row_bytes = image.cols * Channels;
+
+    std::vector<uint8_t>& luma_row = luma_rows_[band];
+    luma_row.resize(static_cast<size_t>(sampled_cols));
+    const uint8_t* luma = luma_row.data();
+
+    uint8_t* cell = cells.glyph.data() + static_cast<size_t>(sy0) * scale * dims_.cols;
+    for (int sy = sy0, y = sy0 * scale; sy < sy1; ++sy) {
+        const LinearTap& tap = row_taps_[sy];
+        linear_luma_(image.ptr<uint8_t>(tap.first), image.ptr<uint8_t>(tap.second), row_bytes, Channels,
+                     column_taps_.data(), sampled_cols, tap.weight[0], tap.weight[1], luma_row.data());
+
+        uint8_t* row_cells = cell;
+        if constexpr (Scaled) {
+            for (int sx = 0, x = 0; x < dims_.cols; ++sx) {
+                const uint8_t glyph = GLYPHS.glyph[luma[sx]];
+                for (int end = std::min(x + scale, dims_.cols); x < end; ++x) *cell++ = glyph;
+            }
+        } else {
+            for (int x = 0; x < dims_.cols; ++x) *cell++ = GLYPHS.glyph[luma[x]];
+        }
+
+        for (++y; y < dims_.rows && y % scale != 0; ++y)
+            cell = std::copy(row_cells, row_cells + dims_.cols, cell);
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+#include "asciinema/quality.h"
+
+#include <algorithm>
+
+namespace asciinema {
+
+namespace {
+    constexpr int DOWN_AFTER = 2;    // windows of pressure before stepping down
+    constexpr int UP_AFTER = 6;      // windows of headroom before stepping up
+
+    constexpr double LOAD_HIGH = 0.85;
+    constexpr double LOAD_LOW = 0.5;
+    constexpr double SLO_HEADROOM = 0.7;
+    constexpr double BACKLOG = 0.5;
+}
+
+void QualityController::reset(RenderMode top_mode, int color_tolerance, Duration slo) {
+    slo_ = slo;
+    level_ = 0;
+    behind_windows_ = 0;
+    headroom_windows_ = 0;
+    signals_ = {};
+    latency_ = {};
+    decode_ = {};
+    process_ = {};
+    draw_ = {};
+    lost_ = 0;
+
+    ladder_.clear();
+    const int wide = std::max(color_tolerance, 8);
+    if (top_mode == RenderMode::HalfBlock) {
+        ladder_.push_back({RenderMode::HalfBlock, 1, color_tolerance});
+        ladder_.push_back({RenderMode::HalfBlock, 1, wide});
+    }
+    if (top_mode == RenderMode::TrueColor || top_mode == RenderMode::HalfBlock) {
+        const int wider = std::max(color_tolerance, 24);
+        ladder_.push_back({RenderMode::TrueColor, 1, color_tolerance});
+        ladder_.push_back({RenderMode::TrueColor, 1, wide});
+        ladder_.push_back({RenderMode::TrueColor, 2, wide});
+        ladder_.push_back({RenderMode::TrueColor, 2, wider});
+        ladder_.push_back({RenderMode::Palette256, 2, 0});
+    } else if (top_mode != RenderMode::ASCII) {
+        ladder_.push_back({top_mode, 1, 0});
+        ladder_.push_back({top_mode, 2, 0});
+    }
+    ladder_.push_back({RenderMode::ASCII, 1, 0});
+    ladder_.push_back({RenderMode::ASCII, 2, 0});
+}
+
+bool QualityController::update(const Metrics& metrics, size_t workers, Duration frame_interval,
+                               double queue_fill) {
+    HistogramSnapshot latency = metrics.latency.snapshot();
+    HistogramSnapshot decode = metrics.decode_time.snapshot();
+    HistogramSnapshot process = metrics.process_time.snapshot();
+    HistogramSnapshot draw = metrics.draw_time.snapshot();
+    uint64_t lost = metrics.frames_dropped.load() + metrics.frames_skipped.load();
+
+    const double budget = std::max(to_ms(frame_interval), 0.001);
+    const double process_share = process.since(process_).p95() / static_cast<double>(std::max<size_t>(workers, 1));
+
+    QualitySignals signals;
+    signals.latency_p95_ms = latency.since(latency_).p95();
+    signals.load = std::max({decode.since(decode_).p95(), process_share, draw.since(draw_).p95()}) / budget;
+    signals.queue_fill = queue_fill;
+    signals.lost = lost - std::min(lost_, lost);
+    const bool sampled = latency.count() > latency_.count() || signals.lost > 0;
+
+    latency_ = latency;
+    decode_ = decode;
+    process_ = process;
+    draw_ = draw;
+    lost_ = lost;
+    signals_ = signals;
+
+    return enabled() && sampled && step(signals);
+}
+
+bool QualityController::step(const QualitySignals& signals) {
+    const double slo_ms = to_ms(slo_);
+    const bool behind = signals.lost > 0 || signals.load > LOAD_HIGH || signals.latency_p95_ms > slo_ms;
+    const bool headroom = signals.lost == 0 && signals.load < LOAD_LOW && signals.queue_fill < BACKLOG &&
+                          signals.latency_p95_ms < slo_ms * SLO_HEADROOM;
+
+    behind_windows_ = behind ? behind_windows_ + 1 : 0;
+    headroom_windows_ = headroom ? headroom_windows_ + 1 : 0;
+
+    if (behind_windows_ >= DOWN_AFTER && level_ + 1 < ladder_.size()) {
+        ++level_;
+    } else if (headroom_windows_ >= UP_AFTER && level_ > 0) {
+        --level_;
+    } else {
+        return false;
+    }
+    behind_windows_ = 0;
+    headroom_windows_ = 0;
+    return true;
+}
+
+}
@@ -1,5 +1,7 @@
 #include "asciinema/renderer.h"
 
+#include <algorithm>
+
 namespace asciinema {
 
     TerminalRenderer::TerminalRenderer() {
@@ -12,27 +14,50 @@ namespace asciinema {
         getmaxyx(win_, rows_, cols_);
     }
 
+    TerminalRenderer::TerminalRenderer(std::FILE* out, Dimensions grid) {
+        screen_ = newterm("xterm", out, stdin);
+        set_term(screen_);
+        resizeterm(grid.rows + 2, grid.cols);
+        win_ = stdscr;
+        curs_set(0);
+        getmaxyx(win_, rows_, cols_);
+    }
+
     TerminalRenderer::~TerminalRenderer() {
         endwin();
+        if (screen_) delscreen(screen_);
     }
 
     Dimensions TerminalRenderer::dimensions() const {
-        return {cols_, rows_ - 2}; 
-    }
-
-    void TerminalRenderer::render(const ProcessedFrame& frame, RenderMode) {
-        move(0, 0);
-        const char* ptr = frame.char_grid.c_str();
-        int y = 0, x = 0;
-        while (*ptr) {
-            if (*ptr == '\n') {
-                y++;
-                x = 0;
-            } else {
-                mvaddch(y, x++, *ptr);
-            }
-            ptr++;
+        return {cols_, rows_ - 2};
+    }
+
+    // Rows that would run into the stats line or past the right edge are
+    // cut off rather than wrapped.
+    void TerminalRenderer::put_row(int y, int x, const char* text, int length) {
+        if (y >= rows_ - 1 || x >= cols_) return;
+        mvwaddnstr(win_, y, x, text, std::min(length, cols_ - x));
+    }
+
+    void TerminalRenderer::render(const ProcessedFrame& frame) {
+        const CellGrid& cells = frame.cells;
+        if (cells.dims.cols != drawn_.cols || cells.dims.rows != drawn_.rows) {
+            werase(win_);
+            drawn_ = cells.dims;
         }
+
+        if (cells.glyph.size() != cells.area()) return;
+        const char* glyph = reinterpret_cast<const char*>(cells.glyph.data());
+        for (int y = 0; y < cells.dims.rows; ++y)
+            put_row(y, 0, glyph + static_cast<size_t>(y) * cells.dims.cols, cells.dims.cols);
+    }
+
+    void TerminalRenderer::render_runs(const ProcessedFrame& frame,
+                                       const std::vector<CellRun>& runs) {
+        const CellGrid& cells = frame.cells;
+        const char* glyph = reinterpret_cast<const char*>(cells.glyph.data());
+        for (const CellRun& run : runs)
+            put_row(run.row, run.col, glyph + static_cast<size_t>(run.row) * cells.dims.cols + run.col, run.length);
     }
 
     void TerminalRenderer::render_stats(const std::string& stats) {
@@ -45,6 +70,7 @@ namespace asciinema {
 
     void TerminalRenderer::clear() {
         erase();
+        drawn_ = {0, 0};
     }
 
     void TerminalRenderer::refresh() {
@@ -52,4 +78,4 @@ namespace asciinema {
         doupdate();
     }
 
-} 
+}
@@ -0,0 +1,67 @@
+#include "asciinema/source.h"
+
+#include <algorithm>
+
+namespace asciinema {
+
+SyntheticSource::SyntheticSource(int width, int height, double fps, size_t loop_frames)
+    : interval_(from_ms(1000.0 / (fps > 0.0 ? fps : 30.0)))
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+    loop_frames = std::max<size_t>(loop_frames, 1);
+
+    int box = std::max(std::min(width, height) / 4, 1);
+    frames_.reserve(loop_frames);
+    for (size_t i = 0; i < loop_frames; ++i) {
+        cv::Mat image(height, width, CV_8UC3);
+        int shift = static_cast<int>(i * 256 / loop_frames);
+
+        for (int y = 0; y < height; ++y) {
+            uint8_t* row = image.ptr<uint8_t>(y);
+            uint8_t g = static_cast<uint8_t>(y * 255 / height);
+            for (int x = 0; x < width; ++x) {
+                row[x * 3 + 0] = static_cast<uint8_t>(x * 255 / width + shift);
+                row[x * 3 + 1] = g;
+                row[x * 3 + 2] = static_cast<uint8_t>(shift - x * 255 / width);
+            }
+        }
+
+        int left = static_cast<int>(i * static_cast<size_t>(width - box) / loop_frames);
+        int top = (height - box) / 2;
+        for (int y = top; y < top + box; ++y) {
+            uint8_t* row = image.ptr<uint8_t>(y);
+            std::fill(row + left * 3, row + (left + box) * 3, uint8_t{255});
+        }
+        frames_.push_back(std::move(image));
+    }
+}
+
+bool SyntheticSource::grab() {
+    if (clip_frames_ && position_ >= clip_frames_) return false;
+    grabbed_position_ = position_++;
+    grabbed_id_ = next_frame_id_++;
+    return true;
+}
+
+bool SyntheticSource::seek_frame(size_t index) {
+    position_ = index;
+    return true;
+}
+
+Duration SyntheticSource::grabbed_pts() const {
+    return interval_ * static_cast<int64_t>(grabbed_id_);
+}
+
+std::optional<RawFrame> SyntheticSource::retrieve() { return retrieve_into(cv::Mat()); }
+
+std::optional<RawFrame> SyntheticSource::retrieve_into(cv::Mat buffer) {
+    const cv::Mat& picture = frames_[grabbed_position_ / hold_frames_ % frames_.size()];
+    if (!copy_frames_) return RawFrame(grabbed_id_, now(), picture, grabbed_pts());
+    picture.copyTo(buffer);
+    return RawFrame(grabbed_id_, now(), std::move(buffer), grabbed_pts());
+}
+
+Duration SyntheticSource::frame_interval() const { return interval_; }
+
+}
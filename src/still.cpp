@@ -0,0 +1,117 @@
+#include "asciinema/still.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define ASCIINEMA_X86 1
+#endif
+
+namespace asciinema {
+
+namespace {
+    constexpr int SAMPLES_PER_CELL_ROW = 4;
+}
+
+uint64_t row_sad_scalar(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bytes; ++i) sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+#ifdef ASCIINEMA_X86
+
+namespace {
+    // psadbw leaves one 16-bit sum per 8 bytes in each 64-bit lane.
+    __attribute__((target("sse2")))
+    uint64_t row_sad_sse2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16)
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+        alignas(16) uint64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        return lanes[0] + lanes[1] + row_sad_scalar(a + i, b + i, bytes - i);
+    }
+
+    __attribute__((target("avx2")))
+    uint64_t row_sad_avx2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+        __m256i acc = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32)
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))));
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + row_sad_sse2(a + i, b + i, bytes - i);
+    }
+}
+
+#endif
+
+RowSadFn select_sad_kernel() {
+#ifdef ASCIINEMA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return row_sad_avx2;
+    if (__builtin_cpu_supports("sse2")) return row_sad_sse2;
+#endif
+    return row_sad_scalar;
+}
+
+const char* sad_kernel_name(RowSadFn kernel) {
+#ifdef ASCIINEMA_X86
+    if (kernel == row_sad_avx2) return "avx2";
+    if (kernel == row_sad_sse2) return "sse2";
+#endif
+    return kernel == row_sad_scalar ? "scalar" : "unknown";
+}
+
+std::vector<RowSadFn> supported_sad_kernels() {
+    std::vector<RowSadFn> kernels;
+#ifdef ASCIINEMA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(row_sad_avx2);
+    if (__builtin_cpu_supports("sse2")) kernels.push_back(row_sad_sse2);
+#endif
+    kernels.push_back(row_sad_scalar);
+    return kernels;
+}
+
+void StillDetector::reset(int threshold, Duration refresh, int grid_rows) {
+    sad_ = select_sad_kernel();
+    threshold_ = threshold;
+    refresh_ = refresh;
+    grid_rows_ = std::max(grid_rows, 1);
+    phase_ = 0;
+    reference_.release();
+    reference_id_ = 0;
+    reference_pts_ = Duration{0};
+}
+
+// Stops at the first row over the threshold, so a changing picture costs
+// little more than its first differing row.
+bool StillDetector::repeats(const cv::Mat& image, FrameId id, Duration pts) {
+    if (!enabled() || image.empty()) return false;
+
+    const int stride = std::max(image.rows / (grid_rows_ * SAMPLES_PER_CELL_ROW), 1);
+    phase_ = (phase_ + 1) % stride;
+
+    bool same = !reference_.empty() && pts - reference_pts_ < refresh_ &&
+                image.rows == reference_.rows && image.cols == reference_.cols &&
+                image.type() == reference_.type();
+    if (same) {
+        const size_t row_bytes = static_cast<size_t>(image.cols) * image.elemSize();
+        const uint64_t limit = static_cast<uint64_t>(threshold_) * row_bytes;
+        for (int y = phase_; same && y < image.rows; y += stride)
+            same = sad_(image.ptr(y), reference_.ptr(y), row_bytes) <= limit;
+    }
+    if (same) return true;
+
+    reference_ = image;
+    reference_id_ = id;
+    reference_pts_ = pts;
+    return false;
+}
+
+}
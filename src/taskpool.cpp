@@ -0,0 +1,122 @@
+#include "asciinema/taskpool.h"
+
+#include "asciinema/queue.h"
+
+#include <algorithm>
+
+namespace asciinema {
+
+namespace {
+    constexpr int SPIN_LIMIT = 4096;
+
+    constexpr uint64_t pack(uint32_t gen, size_t front, size_t back) {
+        return static_cast<uint64_t>(gen) << 32 | static_cast<uint64_t>(front) << 16 | back;
+    }
+
+    constexpr uint32_t gen_of(uint64_t state) { return static_cast<uint32_t>(state >> 32); }
+    constexpr size_t front_of(uint64_t state) { return (state >> 16) & 0xffff; }
+    constexpr size_t back_of(uint64_t state) { return state & 0xffff; }
+}
+
+TaskPool::TaskPool(size_t helpers) : shares_(new Share[helpers + 1]) {
+    helpers_.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i) helpers_.emplace_back(&TaskPool::helper_loop, this, i + 1);
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& helper : helpers_) helper.join();
+}
+
+void TaskPool::run_job(size_t count, TaskFn fn, void* context) {
+    if (count == 0) return;
+    if (helpers_.empty() || count == 1 || count > MAX_TASKS || busy_.exchange(true, std::memory_order_acquire)) {
+        for (size_t i = 0; i < count; ++i) fn(context, i);
+        return;
+    }
+
+    // Zero is the generation every share starts with, so it is never used.
+    if (++generation_ == 0) ++generation_;
+    const uint32_t gen = generation_;
+    fn_.store(fn, std::memory_order_relaxed);
+    context_.store(context, std::memory_order_relaxed);
+    remaining_.store(count, std::memory_order_relaxed);
+
+    const size_t participants = concurrency();
+    for (size_t p = 0; p < participants; ++p)
+        shares_[p].state.store(pack(gen, count * p / participants, count * (p + 1) / participants),
+                               std::memory_order_release);
+
+    epoch_.store(gen, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_all();
+    }
+
+    work(0, gen);
+    while (remaining_.load(std::memory_order_acquire) != 0) cpu_relax();
+    busy_.store(false, std::memory_order_release);
+}
+
+void TaskPool::helper_loop(size_t participant) {
+    uint32_t seen = 0;
+    for (;;) {
+        uint32_t gen = epoch_.load(std::memory_order_acquire);
+        for (int spin = 0; gen == seen; gen = epoch_.load(std::memory_order_acquire)) {
+            if (stopping_.load(std::memory_order_acquire)) return;
+            if (++spin < SPIN_LIMIT) {
+                cpu_relax();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            wake_.wait(lock, [&] {
+                return epoch_.load(std::memory_order_seq_cst) != seen || stopping_.load(std::memory_order_relaxed);
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            spin = 0;
+        }
+        seen = gen;
+        work(participant, gen);
+    }
+}
+
+void TaskPool::work(size_t participant, uint32_t gen) {
+    const size_t participants = concurrency();
+    size_t index;
+    while (take(participant, gen, false, index)) {
+        fn_.load(std::memory_order_relaxed)(context_.load(std::memory_order_relaxed), index);
+        remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    for (size_t step = 1; step < participants; ++step) {
+        const size_t victim = (participant + step) % participants;
+        while (take(victim, gen, true, index)) {
+            fn_.load(std::memory_order_relaxed)(context_.load(std::memory_order_relaxed), index);
+            remaining_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+// A successful CAS acquires the share the caller published after setting
+// fn_ and context_, and the job cannot end, letting them change, while the
+// task taken is unfinished.
+bool TaskPool::take(size_t share, uint32_t gen, bool from_back, size_t& index) {
+    std::atomic<uint64_t>& state = shares_[share].state;
+    uint64_t current = state.load(std::memory_order_acquire);
+    for (;;) {
+        const size_t front = front_of(current);
+        const size_t back = back_of(current);
+        if (gen_of(current) != gen || front >= back) return false;
+        const uint64_t next = from_back ? pack(gen, front, back - 1) : pack(gen, front + 1, back);
+        if (state.compare_exchange_weak(current, next, std::memory_order_acquire, std::memory_order_acquire)) {
+            index = from_back ? back - 1 : front;
+            return true;
+        }
+    }
+}
+
+}
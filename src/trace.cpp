@@ -0,0 +1,125 @@
+#include "asciinema/trace.h"
+
+namespace asciinema {
+
+namespace {
+    constexpr int PID = 1;
+    constexpr int DECODE_TID = 1;
+    constexpr int RENDER_TID = 2;
+    constexpr int WORKER_TID = 10;  // + worker index
+
+    constexpr size_t FLUSH_BYTES = 256 * 1024;
+}
+
+bool TraceWriter::open(const std::string& path, size_t process_workers) {
+    if (file_) return false;
+
+    file_ = std::fopen(path.c_str(), "w");
+    if (!file_) return false;
+
+    buffer_.clear();
+    buffer_.reserve(FLUSH_BYTES + 4096);
+    buffer_ += "[\n";
+    first_event_ = true;
+    origin_ = now();
+    dropped_ = 0;
+
+    char buf[128];
+    auto name_thread = [&](int tid, const std::string& name) {
+        int n = snprintf(buf, sizeof(buf),
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            PID, tid, name.c_str());
+        event(buf, n);
+    };
+    name_thread(DECODE_TID, "decode");
+    name_thread(RENDER_TID, "render");
+    for (size_t i = 0; i < process_workers; ++i)
+        name_thread(WORKER_TID + static_cast<int>(i), "process " + std::to_string(i));
+
+    thread_ = std::thread(&TraceWriter::write_loop, this);
+    return true;
+}
+
+void TraceWriter::close() {
+    if (!file_) return;
+
+    queue_.stop();
+    if (thread_.joinable()) thread_.join();
+
+    buffer_ += "\n]\n";
+    flush();
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void TraceWriter::record(FrameId id, const StageTimes& stages) {
+    if (!queue_.try_push(Record{id, stages}))
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TraceWriter::write_loop() {
+    for (;;) {
+        Record record = queue_.pop();
+        if (!record.valid()) break;
+        write_record(record);
+        if (buffer_.size() >= FLUSH_BYTES) flush();
+    }
+}
+
+void TraceWriter::write_record(const Record& record) {
+    const StageTimes& t = record.stages;
+    const bool written = t.written != TimePoint{};
+    const TimePoint end = written ? t.written : t.render_dequeued;
+
+    complete("decode", DECODE_TID, t.grabbed, t.decoded, record.id);
+    complete("process", WORKER_TID + static_cast<int>(t.worker), t.process_dequeued, t.processed, record.id);
+    if (written) complete("draw", RENDER_TID, t.draw_start, t.written, record.id);
+
+    async("frame", 'b', t.grabbed, record.id);
+    async("process_wait", 'b', t.decoded, record.id);
+    async("process_wait", 'e', t.process_dequeued, record.id);
+    async("render_wait", 'b', t.processed, record.id);
+    async("render_wait", 'e', t.render_dequeued, record.id);
+    if (written) {
+        async("pace", 'b', t.render_dequeued, record.id);
+        async("pace", 'e', t.draw_start, record.id);
+    }
+    async("frame", 'e', end, record.id, written ? "{\"dropped\":false}" : "{\"dropped\":true}");
+}
+
+void TraceWriter::complete(const char* name, int tid, TimePoint start, TimePoint end, FrameId id) {
+    char buf[192];
+    int n = snprintf(buf, sizeof(buf),
+        "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+        name, PID, tid, micros(start), micros(end) - micros(start),
+        static_cast<unsigned long long>(id));
+    event(buf, n);
+}
+
+// Async spans may overlap across frames; Chrome nests those sharing an id.
+// A span's 'b' and 'e' events must carry the same name to pair up.
+void TraceWriter::async(const char* name, char phase, TimePoint at, FrameId id, const char* args) {
+    char buf[192];
+    int n = snprintf(buf, sizeof(buf),
+        "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"id\":%llu,\"pid\":%d,\"tid\":%d,\"ts\":%.3f%s%s}",
+        name, phase, static_cast<unsigned long long>(id), PID, RENDER_TID, micros(at),
+        args ? ",\"args\":" : "", args ? args : "");
+    event(buf, n);
+}
+
+void TraceWriter::event(const char* json, int length) {
+    if (!first_event_) buffer_ += ",\n";
+    first_event_ = false;
+    buffer_.append(json, static_cast<size_t>(length));
+}
+
+void TraceWriter::flush() {
+    if (!buffer_.empty()) std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    buffer_.clear();
+}
+
+double TraceWriter::micros(TimePoint at) const {
+    return to_ms(at - origin_) * 1000.0;
+}
+
+}
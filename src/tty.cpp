@@ -0,0 +1,150 @@
+#include "asciinema/tty.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace asciinema {
+
+namespace {
+    constexpr char SYNC_BEGIN[] = "\033[?2026h";
+    constexpr char SYNC_END[] = "\033[?2026l";
+    constexpr Duration PROBE_TIMEOUT = std::chrono::milliseconds(200);
+    constexpr Duration DRAIN_TIMEOUT = std::chrono::seconds(1);
+
+    int poll_ms(TimePoint deadline) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now());
+        return static_cast<int>(std::max<int64_t>(remaining.count(), 0));
+    }
+}
+
+bool TtyWriter::open(int fd) {
+    close();
+
+    if (isatty(fd)) {
+        if (const char* name = ttyname(fd)) fd_ = ::open(name, O_RDWR | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    }
+    if (fd_ >= 0)
+        synchronized_ = probe_synchronized();
+    else
+        fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+    back_.clear();
+    front_.clear();
+    sent_ = 0;
+    return fd_ >= 0;
+}
+
+void TtyWriter::close() {
+    if (fd_ < 0) return;
+    flush_until(now() + DRAIN_TIMEOUT);
+    ::close(fd_);
+    fd_ = -1;
+    synchronized_ = false;
+}
+
+std::string& TtyWriter::begin_frame() {
+    back_.clear();
+    if (synchronized_) back_ += SYNC_BEGIN;
+    return back_;
+}
+
+bool TtyWriter::submit() {
+    if (!flush()) {
+        metrics_.tty_unsent++;
+        return false;
+    }
+    if (synchronized_) back_ += SYNC_END;
+    front_.swap(back_);
+    sent_ = 0;
+    metrics_.tty_frames++;
+    flush();
+    return true;
+}
+
+bool TtyWriter::flush() {
+    if (fd_ < 0 || sent_ >= front_.size()) return true;
+
+    auto start = now();
+    bool drained = true;
+    while (sent_ < front_.size()) {
+        ssize_t n = ::write(fd_, front_.data() + sent_, front_.size() - sent_);
+        metrics_.tty_writes++;
+        if (n > 0) {
+            sent_ += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            metrics_.tty_stalls++;
+            drained = false;
+            break;
+        } else {
+            // The terminal is gone; nothing more can be shown.
+            sent_ = front_.size();
+        }
+    }
+    metrics_.tty_write_time.record(now() - start);
+    return drained;
+}
+
+void TtyWriter::flush_until(TimePoint deadline) {
+    while (!flush() && now() < deadline) {
+        pollfd ready{fd_, POLLOUT, 0};
+        if (poll(&ready, 1, poll_ms(deadline)) < 0 && errno != EINTR) break;
+    }
+}
+
+void TtyWriter::write_all(std::string_view bytes) {
+    flush_until(now() + DRAIN_TIMEOUT);
+    front_.assign(bytes.data(), bytes.size());
+    sent_ = 0;
+    flush_until(now() + DRAIN_TIMEOUT);
+}
+
+// Asks with DECRQM whether mode 2026 is known, then for the primary device
+// attributes, which every terminal answers: once that reply is in, so is
+// any reply to the first question. Echo and line buffering are off while
+// waiting so the replies neither show nor wait for a newline.
+bool TtyWriter::probe_synchronized() {
+    termios saved;
+    if (tcgetattr(fd_, &saved) != 0) return false;
+    termios raw = saved;
+    raw.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(fd_, TCSANOW, &raw) != 0) return false;
+
+    static constexpr char QUERY[] = "\033[?2026$p\033[c";
+    std::string reply;
+    TimePoint deadline = now() + PROBE_TIMEOUT;
+    if (::write(fd_, QUERY, sizeof(QUERY) - 1) == static_cast<ssize_t>(sizeof(QUERY) - 1)) {
+        char buf[64];
+        while (now() < deadline) {
+            pollfd ready{fd_, POLLIN, 0};
+            int polled = poll(&ready, 1, poll_ms(deadline));
+            if (polled < 0 && errno != EINTR) break;
+            if (polled <= 0) continue;
+            // A hung-up or broken terminal would report ready until the deadline.
+            if (ready.revents & (POLLERR | POLLHUP | POLLNVAL)) break;
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n < 0 && errno != EINTR && errno != EAGAIN) break;
+            if (n > 0) reply.append(buf, static_cast<size_t>(n));
+            size_t last = reply.rfind("\033[?");
+            if (last != std::string::npos && reply.find('c', last) != std::string::npos) break;
+        }
+    }
+    tcsetattr(fd_, TCSANOW, &saved);
+
+    // "ESC [ ? 2026 ; Ps $ y", where Ps is 1 (set) or 2 (reset) if known.
+    static constexpr char ANSWER[] = "\033[?2026;";
+    size_t at = reply.find(ANSWER);
+    if (at == std::string::npos) return false;
+    at += sizeof(ANSWER) - 1;
+    return reply.size() >= at + 3 && (reply[at] == '1' || reply[at] == '2') && reply.compare(at + 1, 2, "$y") == 0;
+}
+
+}
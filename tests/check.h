@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertion helpers shared by the test executables. A failed CHECK
+// reports and keeps going so one run lists every broken expectation.
+namespace asciinema::test {
+
+inline int failures = 0;
+
+}  
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++asciinema::test::failures;                                        \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#define TEST_RESULT() (asciinema::test::failures == 0 ? 0 : 1)
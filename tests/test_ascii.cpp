@@ -0,0 +1,104 @@
+#include "asciinema/processor.h"
+#include "check.h"
+
+#include <opencv2/imgproc.hpp>
+#include <random>
+
+using namespace asciinema;
+
+namespace {
+
+cv::Mat random_image(std::mt19937& rng, int width, int height, int channels) {
+    cv::Mat image(height, width, CV_8UC(channels));
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = image.ptr<uint8_t>(y);
+        for (int x = 0; x < width * channels; ++x) row[x] = static_cast<uint8_t>(rng());
+    }
+    return image;
+}
+
+// What the ASCII path did before it was fused: cv::resize to the sampled
+// grid, cv::cvtColor to gray, a ramp lookup, and each sample repeated over
+// its scale x scale block.
+std::vector<uint8_t> reference_glyphs(const cv::Mat& image, Dimensions dims, int scale) {
+    cv::Mat resized, gray;
+    cv::resize(image, resized, cv::Size((dims.cols + scale - 1) / scale, (dims.rows + scale - 1) / scale));
+    if (resized.channels() == 3)
+        cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
+    else if (resized.channels() == 4)
+        cv::cvtColor(resized, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = resized;
+
+    std::vector<uint8_t> glyphs(static_cast<size_t>(dims.area()));
+    for (int y = 0; y < dims.rows; ++y) {
+        const uint8_t* row = gray.ptr<uint8_t>(y / scale);
+        for (int x = 0; x < dims.cols; ++x) glyphs[static_cast<size_t>(y) * dims.cols + x] = GLYPHS.glyph[row[x / scale]];
+    }
+    return glyphs;
+}
+
+void matches_reference(FrameProcessor& processor, const cv::Mat& image, int scale) {
+    processor.set_cell_scale(scale);
+    ProcessedFrame frame = processor.process(RawFrame(0, Clock::now(), image));
+    CHECK(frame.cells.glyph == reference_glyphs(image, processor.dimensions(), scale));
+    processor.recycle(std::move(frame));
+}
+
+// Downscales, upscales, odd sizes and images smaller than one sample, in
+// every channel layout and cell scale, reusing one processor so cached
+// taps are refreshed when the image or grid changes.
+void matches_resize_and_cvtcolor() {
+    const Dimensions grids[] = {{80, 24}, {160, 45}, {37, 11}, {1, 1}, {300, 90}};
+    const cv::Size sources[] = {{1280, 720}, {640, 360}, {333, 97}, {81, 25}, {40, 12}, {7, 3}, {1, 1}};
+    std::mt19937 rng(11);
+    FrameProcessor processor({80, 24}, RenderMode::ASCII);
+    for (int channels : {1, 3, 4}) {
+        for (const cv::Size& source : sources) {
+            const cv::Mat image = random_image(rng, source.width, source.height, channels);
+            for (const Dimensions& grid : grids) {
+                processor.set_dimensions(grid);
+                for (int scale : {1, 2, 3}) matches_reference(processor, image, scale);
+            }
+        }
+    }
+}
+
+// At exactly twice the sampled grid both ways, cv::resize averages 2x2
+// blocks (INTER_AREA) instead of interpolating.
+void matches_exact_halving() {
+    const Dimensions grids[] = {{160, 45}, {80, 24}, {37, 11}, {1, 1}, {3, 250}};
+    std::mt19937 rng(17);
+    FrameProcessor processor({80, 24}, RenderMode::ASCII);
+    for (int channels : {1, 3, 4}) {
+        for (const Dimensions& grid : grids) {
+            processor.set_dimensions(grid);
+            for (int scale : {1, 2, 3}) {
+                const int cols = (grid.cols + scale - 1) / scale;
+                const int rows = (grid.rows + scale - 1) / scale;
+                matches_reference(processor, random_image(rng, 2 * cols, 2 * rows, channels), scale);
+            }
+        }
+    }
+}
+
+// Row bands split the same rows differently; the glyphs must not change.
+void bands_match_reference() {
+    TaskPool pool(3);
+    std::mt19937 rng(13);
+    FrameProcessor processor({320, 120}, RenderMode::ASCII);
+    processor.set_band_pool(&pool);
+    for (int channels : {1, 3, 4}) {
+        const cv::Mat image = random_image(rng, 1280, 720, channels);
+        for (int scale : {1, 2}) matches_reference(processor, image, scale);
+    }
+}
+
+}
+
+int main() {
+    matches_resize_and_cvtcolor();
+    matches_exact_halving();
+    bands_match_reference();
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+#include "asciinema/delta.h"
+#include "check.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace asciinema;
+
+namespace {
+
+constexpr Dimensions DIMS{41, 13};
+
+ProcessedFrame ascii_frame(std::mt19937& rng) {
+    ProcessedFrame frame;
+    frame.cells.reset(DIMS, RenderMode::ASCII);
+    for (uint8_t& glyph : frame.cells.glyph) glyph = static_cast<uint8_t>(' ' + rng() % 95);
+    return frame;
+}
+
+// Plays cursor moves and printable bytes onto a screen of glyphs, the way a
+// terminal would.
+void play(const std::string& bytes, std::vector<uint8_t>& screen) {
+    size_t at = 0;
+    for (size_t i = 0; i < bytes.size();) {
+        if (bytes[i] == '\033') {
+            const size_t end = bytes.find('H', i);
+            CHECK(end != std::string::npos);
+            if (end == std::string::npos) return;
+            int row = 0;
+            int col = 0;
+            CHECK_EQ(std::sscanf(bytes.c_str() + i, "\033[%d;%dH", &row, &col), 2);
+            CHECK(row >= 1 && row <= DIMS.rows && col >= 1 && col <= DIMS.cols);
+            at = static_cast<size_t>(row - 1) * DIMS.cols + static_cast<size_t>(col - 1);
+            i = end + 1;
+        } else {
+            CHECK(at < screen.size());
+            if (at < screen.size()) screen[at++] = static_cast<uint8_t>(bytes[i]);
+            ++i;
+        }
+    }
+}
+
+// Runs cover every changed cell, stay in their row, and replaying their
+// encoding over the old screen gives the new one.
+void runs_repaint_changes() {
+    std::mt19937 rng(3);
+    DeltaTracker tracker;
+    std::vector<CellRun> runs;
+
+    ProcessedFrame first = ascii_frame(rng);
+    std::vector<uint8_t> screen = first.cells.glyph;
+    CHECK(!tracker.diff(first, runs));  // nothing on screen yet
+    tracker.present(first);
+
+    for (int step = 0; step < 200; ++step) {
+        ProcessedFrame next;
+        next.cells.reset(DIMS, RenderMode::ASCII);
+        next.cells.glyph = screen;
+        const int edits = static_cast<int>(rng() % 12);
+        for (int e = 0; e < edits; ++e)
+            next.cells.glyph[rng() % next.cells.area()] = static_cast<uint8_t>(' ' + rng() % 95);
+        const std::vector<uint8_t> expected = next.cells.glyph;
+
+        size_t changed = 0;
+        for (size_t i = 0; i < expected.size(); ++i) changed += expected[i] != screen[i];
+
+        CHECK(tracker.diff(next, runs));
+        CHECK_EQ(tracker.changed_cells(), changed);
+        if (changed == 0) CHECK(runs.empty());
+        for (const CellRun& run : runs) {
+            CHECK(run.length > 0);
+            CHECK(run.row >= 0 && run.row < DIMS.rows);
+            CHECK(run.col >= 0 && run.col + run.length <= DIMS.cols);
+        }
+
+        std::string bytes;
+        encode_ascii_runs(next.cells, runs, bytes);
+        play(bytes, screen);
+        CHECK(screen == expected);
+        tracker.present(next);
+    }
+}
+
+// A new size, a new mode or a forgotten screen needs a full repaint, and so
+// does a frame that changes most cells.
+void full_repaints() {
+    std::mt19937 rng(9);
+    DeltaTracker tracker;
+    std::vector<CellRun> runs;
+    ProcessedFrame frame = ascii_frame(rng);
+    tracker.present(frame);
+
+    ProcessedFrame changed = ascii_frame(rng);
+    CHECK(!tracker.diff(changed, runs));
+
+    ProcessedFrame resized;
+    resized.cells.reset({DIMS.cols + 1, DIMS.rows}, RenderMode::ASCII);
+    CHECK(!tracker.diff(resized, runs));
+
+    ProcessedFrame color;
+    color.cells.reset(DIMS, RenderMode::TrueColor);
+    CHECK(!tracker.diff(color, runs));
+
+    ProcessedFrame same;
+    same.cells = changed.cells;
+    tracker.present(changed);
+    tracker.invalidate();
+    CHECK(!tracker.diff(same, runs));
+}
+
+}
+
+int main() {
+    runs_repaint_changes();
+    full_repaints();
+    return TEST_RESULT();
+}
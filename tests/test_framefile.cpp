@@ -0,0 +1,147 @@
+#include "asciinema/framefile.h"
+#include "check.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace asciinema;
+
+namespace {
+
+const std::string PATH = (std::filesystem::temp_directory_path() / "asciinema_test_framefile.bin").string();
+constexpr Dimensions DIMS{23, 7};
+constexpr Duration INTERVAL = std::chrono::milliseconds(40);
+
+// Values each mode can store: glyph bytes, palette indices, or 24-bit colors.
+void randomize(CellGrid& cells, std::mt19937& rng, size_t first, size_t count) {
+    const uint32_t color_mask = cells.mode == RenderMode::Palette16    ? 0xFu
+                                : cells.mode == RenderMode::Palette256 ? 0xFFu
+                                                                       : 0xFFFFFFu;
+    for (size_t i = first; i < first + count; ++i) {
+        if (!cells.glyph.empty()) cells.glyph[i] = static_cast<uint8_t>(rng());
+        if (!cells.fg.empty()) cells.fg[i] = rng() & color_mask;
+        if (!cells.bg.empty()) cells.bg[i] = rng() & color_mask;
+    }
+}
+
+// A key frame, small edits, an unchanged frame and a full change, so the
+// file holds key frames, delta runs and empty deltas.
+std::vector<CellGrid> clip(RenderMode mode) {
+    std::mt19937 rng(static_cast<unsigned>(mode) + 1);
+    std::vector<CellGrid> frames;
+    CellGrid cells;
+    cells.reset(DIMS, mode);
+    randomize(cells, rng, 0, cells.area());
+    frames.push_back(cells);
+    for (int i = 0; i < 4; ++i) {
+        randomize(cells, rng, rng() % (cells.area() - 5), 1 + rng() % 5);
+        frames.push_back(cells);
+    }
+    frames.push_back(cells);
+    randomize(cells, rng, 0, cells.area());
+    frames.push_back(cells);
+    return frames;
+}
+
+bool same_cells(const CellGrid& a, const CellGrid& b) {
+    return a.dims.cols == b.dims.cols && a.dims.rows == b.dims.rows && a.mode == b.mode &&
+           a.glyph == b.glyph && a.fg == b.fg && a.bg == b.bg;
+}
+
+void round_trips(RenderMode mode) {
+    const std::vector<CellGrid> frames = clip(mode);
+    {
+        FrameFileWriter writer;
+        CHECK(writer.open(PATH, DIMS, mode, INTERVAL));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            ProcessedFrame frame;
+            frame.cells = frames[i];
+            frame.pts = INTERVAL * static_cast<int64_t>(i);
+            CHECK(writer.append(frame));
+        }
+        CHECK_EQ(writer.frames(), frames.size());
+        CHECK(writer.close());
+    }
+
+    CHECK(FrameFileReader::is_frame_file(PATH));
+    FrameFileReader reader;
+    CHECK(reader.open(PATH));
+    if (!reader.is_open()) return;
+    CHECK_EQ(reader.dimensions().cols, DIMS.cols);
+    CHECK_EQ(reader.dimensions().rows, DIMS.rows);
+    CHECK(reader.mode() == mode);
+    CHECK(reader.frame_interval() == INTERVAL);
+    CHECK_EQ(reader.frame_count(), frames.size());
+
+    // Twice through, so rewinding replays the same cells with ids and pts
+    // still increasing.
+    ProcessedFrame frame;
+    FrameId id = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        const Duration base = INTERVAL * static_cast<int64_t>(pass * frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            CHECK(reader.next(frame));
+            CHECK(same_cells(frame.cells, frames[i]));
+            CHECK_EQ(frame.id, id++);
+            CHECK(frame.pts == base + INTERVAL * static_cast<int64_t>(i));
+        }
+        CHECK(!reader.next(frame));
+        reader.rewind();
+    }
+}
+
+// Frames of another size or mode are refused rather than written.
+void rejects_mismatched_frames() {
+    FrameFileWriter writer;
+    CHECK(writer.open(PATH, DIMS, RenderMode::ASCII, INTERVAL));
+    ProcessedFrame frame;
+    frame.cells.reset({DIMS.cols + 1, DIMS.rows}, RenderMode::ASCII);
+    CHECK(!writer.append(frame));
+    frame.cells.reset(DIMS, RenderMode::TrueColor);
+    CHECK(!writer.append(frame));
+    CHECK_EQ(writer.frames(), 0u);
+    CHECK(writer.close());
+}
+
+// A file closed before any frame still has a header and an empty index.
+void writes_empty_files() {
+    {
+        FrameFileWriter writer;
+        CHECK(writer.open(PATH, DIMS, RenderMode::ASCII, INTERVAL));
+        CHECK(writer.close());
+    }
+    CHECK(FrameFileReader::is_frame_file(PATH));
+    FrameFileReader reader;
+    if (reader.open(PATH)) {
+        CHECK_EQ(reader.frame_count(), 0u);
+        ProcessedFrame frame;
+        CHECK(!reader.next(frame));
+    }
+}
+
+void rejects_other_files() {
+    std::FILE* file = std::fopen(PATH.c_str(), "wb");
+    CHECK(file != nullptr);
+    if (!file) return;
+    std::fputs("not a frame file, just some text that is long enough", file);
+    std::fclose(file);
+
+    CHECK(!FrameFileReader::is_frame_file(PATH));
+    FrameFileReader reader;
+    CHECK(!reader.open(PATH));
+}
+
+}
+
+int main() {
+    for (RenderMode mode : {RenderMode::ASCII, RenderMode::TrueColor, RenderMode::Palette256,
+                            RenderMode::Palette16, RenderMode::HalfBlock})
+        round_trips(mode);
+    rejects_mismatched_frames();
+    writes_empty_files();
+    rejects_other_files();
+    std::remove(PATH.c_str());
+    return TEST_RESULT();
+}
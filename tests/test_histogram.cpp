@@ -0,0 +1,62 @@
+#include "asciinema/histogram.h"
+#include "check.h"
+
+#include <thread>
+#include <vector>
+
+using namespace asciinema;
+
+namespace {
+
+// Every writer's samples land in the merged snapshot, including writers
+// past the shard count, which share a shard.
+void merges_every_writer() {
+    constexpr size_t WRITERS = 6;
+    constexpr int SAMPLES = 20000;
+    Histogram histogram(4);
+    CHECK_EQ(histogram.writers(), 4u);
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&histogram, w] {
+            for (int i = 0; i < SAMPLES; ++i) histogram.record(Duration(static_cast<int64_t>(w + 1) * 1000), w);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    HistogramSnapshot snapshot = histogram.snapshot();
+    CHECK_EQ(snapshot.count(), WRITERS * SAMPLES);
+    CHECK_EQ(snapshot.max(), to_ms(Duration(WRITERS * 1000)));
+    uint64_t sum_us = 0;
+    for (size_t w = 0; w < WRITERS; ++w) sum_us += (w + 1) * SAMPLES;
+    CHECK_EQ(snapshot.sum(), to_ms(Duration(static_cast<int64_t>(sum_us) * 1000)));
+}
+
+void set_writers_clears() {
+    Histogram histogram;
+    CHECK_EQ(histogram.writers(), 1u);
+    histogram.record(Duration(5000), 3);
+    CHECK_EQ(histogram.snapshot().count(), 1u);
+
+    histogram.set_writers(0);
+    CHECK_EQ(histogram.writers(), 1u);
+    CHECK_EQ(histogram.snapshot().count(), 0u);
+}
+
+void percentiles_within_a_bucket() {
+    Histogram histogram(2);
+    for (int ms = 1; ms <= 100; ++ms) histogram.record(static_cast<double>(ms), static_cast<size_t>(ms % 2));
+    HistogramSnapshot snapshot = histogram.snapshot();
+    CHECK(snapshot.p50() > 48.0 && snapshot.p50() < 52.0);
+    CHECK(snapshot.p99() > 96.0 && snapshot.p99() <= 100.0);
+    CHECK_EQ(snapshot.max(), 100.0);
+}
+
+}
+
+int main() {
+    merges_every_writer();
+    set_writers_clears();
+    percentiles_within_a_bucket();
+    return TEST_RESULT();
+}
@@ -0,0 +1,86 @@
+#include "asciinema/luma.h"
+#include "check.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using asciinema::LinearTap;
+using asciinema::LumaRowFn;
+
+namespace {
+
+// Columns as update_linear_taps builds them: moving right, the second pixel
+// next to the first, and clamped to the last pixel with no weight past it.
+std::vector<LinearTap> random_columns(std::mt19937& rng, int src_width, int channels, int width) {
+    std::vector<LinearTap> columns(width);
+    std::uniform_int_distribution<int> weight(0, 2048);
+    int x = 0;
+    for (int i = 0; i < width; ++i) {
+        x = std::min(x + static_cast<int>(rng() % 3), src_width - 1);
+        LinearTap& tap = columns[i];
+        if (x >= src_width - 1) {
+            tap = {x * channels, x * channels, {2048, 0}};
+            continue;
+        }
+        const int w0 = weight(rng);
+        tap = {x * channels, (x + 1) * channels, {w0, 2048 - w0}};
+    }
+    return columns;
+}
+
+// Every kernel must match the scalar one byte for byte, including samples
+// whose pixels end the row.
+void kernels_match_scalar(LumaRowFn kernel) {
+    std::mt19937 rng(7);
+    for (int channels : {1, 3, 4}) {
+        for (int width = 1; width <= 300; width += (width < 20 ? 1 : 7)) {
+            const int src_width = width + static_cast<int>(rng() % (2 * width + 1));
+            const int row_bytes = src_width * channels;
+            std::vector<uint8_t> top(row_bytes);
+            std::vector<uint8_t> bottom(row_bytes);
+            for (auto& v : top) v = static_cast<uint8_t>(rng());
+            for (auto& v : bottom) v = static_cast<uint8_t>(rng());
+
+            const auto columns = random_columns(rng, src_width, channels, width);
+            const int beta0 = static_cast<int>(rng() % 2049);
+            std::vector<uint8_t> expected(width);
+            std::vector<uint8_t> actual(width);
+            asciinema::linear_luma_scalar(top.data(), bottom.data(), row_bytes, channels, columns.data(), width,
+                                          beta0, 2048 - beta0, expected.data());
+            kernel(top.data(), bottom.data(), row_bytes, channels, columns.data(), width, beta0, 2048 - beta0,
+                   actual.data());
+            CHECK(actual == expected);
+        }
+    }
+}
+
+// Hand-checked against cv::resize + cv::cvtColor: a half-way blend of black
+// and white rounds up to 128, and pure channels use OpenCV's gray weights.
+void scalar_matches_opencv_rounding() {
+    const uint8_t black[3] = {0, 0, 0};
+    const uint8_t white[3] = {255, 255, 255};
+    const LinearTap same = {0, 0, {2048, 0}};
+    uint8_t luma = 0;
+    asciinema::linear_luma_scalar(black, white, 3, 3, &same, 1, 1024, 1024, &luma);
+    CHECK_EQ(luma, 128);
+
+    const uint8_t blue[3] = {255, 0, 0};
+    const uint8_t green[3] = {0, 255, 0};
+    const uint8_t red[3] = {0, 0, 255};
+    asciinema::linear_luma_scalar(blue, blue, 3, 3, &same, 1, 2048, 0, &luma);
+    CHECK_EQ(luma, 29);
+    asciinema::linear_luma_scalar(green, green, 3, 3, &same, 1, 2048, 0, &luma);
+    CHECK_EQ(luma, 150);
+    asciinema::linear_luma_scalar(red, red, 3, 3, &same, 1, 2048, 0, &luma);
+    CHECK_EQ(luma, 76);
+}
+
+}
+
+int main() {
+    for (LumaRowFn kernel : asciinema::supported_luma_kernels()) kernels_match_scalar(kernel);
+    CHECK(asciinema::select_luma_kernel() == asciinema::supported_luma_kernels().front());
+    scalar_matches_opencv_rounding();
+    return TEST_RESULT();
+}
@@ -0,0 +1,142 @@
+#include "asciinema/quality.h"
+#include "check.h"
+
+using namespace asciinema;
+
+namespace {
+
+constexpr Duration INTERVAL = std::chrono::milliseconds(10);
+constexpr Duration SLO = std::chrono::milliseconds(50);
+
+// One window of frames with the given latency and per-frame service times.
+void window(Metrics& metrics, double latency_ms, double service_ms, int frames = 20) {
+    for (int i = 0; i < frames; ++i) {
+        metrics.latency.record(latency_ms);
+        metrics.decode_time.record(service_ms);
+        metrics.process_time.record(service_ms);
+        metrics.draw_time.record(service_ms);
+    }
+}
+
+void ladder_runs_down_to_ascii() {
+    QualityController controller;
+    controller.reset(RenderMode::TrueColor, 0, SLO);
+    CHECK(controller.enabled());
+    CHECK(controller.levels() > 2);
+    CHECK(controller.level(0).mode == RenderMode::TrueColor);
+    CHECK_EQ(controller.level(0).cell_scale, 1);
+    CHECK_EQ(controller.level(0).color_tolerance, 0);
+    const QualityLevel& last = controller.level(controller.levels() - 1);
+    CHECK(last.mode == RenderMode::ASCII);
+    CHECK_EQ(last.cell_scale, 2);
+
+    controller.reset(RenderMode::ASCII, 0, SLO);
+    CHECK_EQ(controller.levels(), 2u);
+}
+
+// Latency over the SLO steps down after two windows, one rung at a time,
+// and stops at the bottom.
+void steps_down_under_pressure() {
+    Metrics metrics;
+    QualityController controller;
+    controller.reset(RenderMode::TrueColor, 0, SLO);
+
+    window(metrics, 80.0, 2.0);
+    CHECK(!controller.update(metrics, 1, INTERVAL, 0.0));
+    window(metrics, 80.0, 2.0);
+    CHECK(controller.update(metrics, 1, INTERVAL, 0.0));
+    CHECK_EQ(controller.level_index(), 1u);
+
+    for (size_t i = 0; i < 4 * controller.levels(); ++i) {
+        window(metrics, 80.0, 2.0);
+        (void)controller.update(metrics, 1, INTERVAL, 0.0);
+    }
+    CHECK_EQ(controller.level_index(), controller.levels() - 1);
+}
+
+// Recovery takes six windows of headroom and climbs one rung at a time.
+void steps_up_with_headroom() {
+    Metrics metrics;
+    QualityController controller;
+    controller.reset(RenderMode::TrueColor, 0, SLO);
+    for (int i = 0; i < 4; ++i) {
+        window(metrics, 80.0, 2.0);
+        (void)controller.update(metrics, 1, INTERVAL, 0.0);
+    }
+    CHECK_EQ(controller.level_index(), 2u);
+
+    for (int i = 0; i < 5; ++i) {
+        window(metrics, 5.0, 1.0);
+        CHECK(!controller.update(metrics, 1, INTERVAL, 0.0));
+    }
+    window(metrics, 5.0, 1.0);
+    CHECK(controller.update(metrics, 1, INTERVAL, 0.0));
+    CHECK_EQ(controller.level_index(), 1u);
+
+    // A backlog in front of the workers is not headroom.
+    for (int i = 0; i < 8; ++i) {
+        window(metrics, 5.0, 1.0);
+        CHECK(!controller.update(metrics, 1, INTERVAL, 0.9));
+    }
+    CHECK_EQ(controller.level_index(), 1u);
+}
+
+// Lost frames and a stage slower than the frame interval count as
+// pressure; process time is shared across the workers.
+void loss_and_load_are_pressure() {
+    Metrics metrics;
+    QualityController controller;
+    controller.reset(RenderMode::TrueColor, 0, SLO);
+
+    for (int i = 0; i < 2; ++i) {
+        metrics.frames_dropped += 3;
+        (void)controller.update(metrics, 1, INTERVAL, 0.0);
+    }
+    CHECK_EQ(controller.level_index(), 1u);
+    CHECK_EQ(controller.signals().lost, 3u);
+
+    for (int i = 0; i < 2; ++i) {
+        window(metrics, 5.0, 0.0);
+        for (int f = 0; f < 20; ++f) metrics.process_time.record(15.0);
+        (void)controller.update(metrics, 1, INTERVAL, 0.0);
+    }
+    CHECK_EQ(controller.level_index(), 2u);
+
+    for (int i = 0; i < 2; ++i) {
+        window(metrics, 5.0, 0.0);
+        for (int f = 0; f < 20; ++f) metrics.process_time.record(15.0);
+        CHECK(!controller.update(metrics, 4, INTERVAL, 0.0));
+    }
+    CHECK(controller.signals().load < 0.5);
+    CHECK_EQ(controller.level_index(), 2u);
+}
+
+// Windows with no new frames and a disabled controller change nothing.
+void idle_and_disabled_hold() {
+    Metrics metrics;
+    QualityController controller;
+    controller.reset(RenderMode::TrueColor, 0, SLO);
+    window(metrics, 80.0, 2.0);
+    (void)controller.update(metrics, 1, INTERVAL, 0.0);
+    for (int i = 0; i < 4; ++i) CHECK(!controller.update(metrics, 1, INTERVAL, 0.0));
+    CHECK_EQ(controller.level_index(), 0u);
+
+    controller.reset(RenderMode::TrueColor, 0, Duration::zero());
+    CHECK(!controller.enabled());
+    for (int i = 0; i < 4; ++i) {
+        window(metrics, 80.0, 20.0);
+        CHECK(!controller.update(metrics, 1, INTERVAL, 1.0));
+    }
+    CHECK_EQ(controller.level_index(), 0u);
+}
+
+}
+
+int main() {
+    ladder_runs_down_to_ascii();
+    steps_down_under_pressure();
+    steps_up_with_headroom();
+    loss_and_load_are_pressure();
+    idle_and_disabled_hold();
+    return TEST_RESULT();
+}
@@ -0,0 +1,107 @@
+#include "asciinema/queue.h"
+#include "check.h"
+
+#include <thread>
+
+using asciinema::SpscQueue;
+
+namespace {
+
+// A full queue must reject the next push rather than overwrite the unread item,
+// at every lap of the ring.
+void fills_and_drains(size_t requested) {
+    SpscQueue<int> queue(requested);
+    const size_t capacity = queue.capacity();
+    CHECK(capacity >= 2);
+    CHECK(capacity >= requested);
+
+    int next_in = 0;
+    int next_out = 0;
+    for (int lap = 0; lap < 4; ++lap) {
+        for (size_t i = 0; i < capacity; ++i) CHECK(queue.try_push(next_in++));
+        CHECK(!queue.try_push(-1));
+        CHECK(queue.full());
+        CHECK_EQ(queue.size(), capacity);
+
+        for (size_t i = 0; i < capacity; ++i) {
+            auto item = queue.try_pop();
+            CHECK(item.has_value());
+            if (item) CHECK_EQ(*item, next_out);
+            ++next_out;
+        }
+        CHECK(!queue.try_pop().has_value());
+        CHECK(queue.empty());
+    }
+}
+
+void push_latest_evicts_oldest(size_t requested) {
+    SpscQueue<int> queue(requested);
+    const int capacity = static_cast<int>(queue.capacity());
+    for (int i = 0; i < capacity; ++i) CHECK_EQ(queue.push_latest(i), 0u);
+    CHECK_EQ(queue.push_latest(capacity), 1u);
+    CHECK_EQ(queue.size(), queue.capacity());
+
+    for (int i = 1; i <= capacity; ++i) {
+        auto item = queue.try_pop();
+        CHECK(item.has_value());
+        if (item) CHECK_EQ(*item, i);
+    }
+    CHECK(queue.empty());
+}
+
+// Blocking push/pop across threads: every item arrives once and in order.
+void threaded_round_trip(size_t requested) {
+    constexpr int COUNT = 20000;
+    SpscQueue<int> queue(requested);
+    std::thread producer([&] {
+        for (int i = 1; i <= COUNT; ++i) queue.push(i);
+    });
+
+    bool in_order = true;
+    for (int i = 1; i <= COUNT; ++i)
+        if (queue.pop() != i) in_order = false;
+    producer.join();
+    CHECK(in_order);
+    CHECK(queue.empty());
+}
+
+void stop_wakes_blocked_pop() {
+    SpscQueue<int> queue(2);
+    std::thread consumer([&] { CHECK_EQ(queue.pop(), 0); });
+    queue.stop();
+    consumer.join();
+}
+
+// Items pushed before stop() still come out of pop(), and only then T{}.
+void stop_drains_queued_items() {
+    SpscQueue<int> queue(4);
+    for (int i = 1; i <= 3; ++i) CHECK(queue.try_push(i));
+    queue.stop();
+    for (int i = 1; i <= 3; ++i) CHECK_EQ(queue.pop(), i);
+    CHECK_EQ(queue.pop(), 0);
+
+    // The same with the consumer already waiting when the last item and the
+    // stop arrive back to back.
+    for (int round = 0; round < 2000; ++round) {
+        SpscQueue<int> racing(2);
+        int got = -1;
+        std::thread consumer([&] { got = racing.pop(); });
+        racing.push(7);
+        racing.stop();
+        consumer.join();
+        CHECK_EQ(got, 7);
+    }
+}
+
+}  
+
+int main() {
+    for (size_t capacity : {1, 2, 3, 8}) {
+        fills_and_drains(capacity);
+        push_latest_evicts_oldest(capacity);
+        threaded_round_trip(capacity);
+    }
+    stop_wakes_blocked_pop();
+    stop_drains_queued_items();
+    return TEST_RESULT();
+}
@@ -0,0 +1,151 @@
+#include "asciinema/reorder.h"
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using asciinema::FrameId;
+using asciinema::ProcessedFrame;
+using asciinema::ReorderBuffer;
+
+namespace {
+
+ProcessedFrame frame(FrameId id) {
+    ProcessedFrame f;
+    f.id = id;
+    return f;
+}
+
+struct Collector {
+    std::vector<FrameId> ids;
+    void operator()(ProcessedFrame&& f) { ids.push_back(f.id); }
+};
+
+void restores_order_across_producers() {
+    ReorderBuffer buffer(2, 8);
+    Collector out;
+    buffer.insert(1, frame(1), out);
+    buffer.insert(1, frame(3), out);
+    CHECK(out.ids.empty());
+    buffer.insert(0, frame(0), out);
+    CHECK((out.ids == std::vector<FrameId>{0, 1}));
+    buffer.insert(0, frame(2), out);
+    CHECK((out.ids == std::vector<FrameId>{0, 1, 2, 3}));
+}
+
+// A producer skipping exactly the next expected id must not stall delivery.
+void skip_of_next_id_releases_it() {
+    ReorderBuffer buffer(1, 8);
+    Collector out;
+    buffer.skip(0, 0, out);
+    buffer.insert(0, frame(1), out);
+    CHECK((out.ids == std::vector<FrameId>{1}));
+
+    ReorderBuffer pair(2, 8);
+    Collector both;
+    pair.insert(1, frame(1), both);
+    pair.skip(0, 0, both);
+    CHECK((both.ids == std::vector<FrameId>{1}));
+    pair.skip(1, 3, both);
+    pair.insert(0, frame(2), both);
+    CHECK((both.ids == std::vector<FrameId>{1, 2}));
+    pair.insert(0, frame(4), both);
+    CHECK((both.ids == std::vector<FrameId>{1, 2, 4}));
+}
+
+// Ids no producer ever saw are given up on once every producer is past them,
+// but not while one of them has reported nothing yet.
+void gaps_wait_for_every_producer() {
+    ReorderBuffer buffer(2, 8);
+    Collector out;
+    buffer.insert(0, frame(2), out);
+    CHECK(out.ids.empty());
+    buffer.insert(1, frame(3), out);
+    CHECK((out.ids == std::vector<FrameId>{2, 3}));
+}
+
+void window_forces_progress_and_late_frames_drop() {
+    ReorderBuffer buffer(2, 4);
+    Collector out;
+    buffer.insert(0, frame(1), out);
+    buffer.insert(0, frame(5), out);  // id 0 never came from producer 1
+    CHECK((out.ids == std::vector<FrameId>{1}));
+    CHECK_EQ(buffer.insert(1, frame(0), out), 1u);
+    buffer.insert(1, frame(6), out);
+    CHECK((out.ids == std::vector<FrameId>{1, 5, 6}));
+}
+
+// A release that blocks holds up only later releases, not other producers'
+// inserts and skips.
+void blocked_release_does_not_hold_the_buffer() {
+    ReorderBuffer buffer(2, 8);
+    std::atomic<bool> entered{false};
+    std::atomic<bool> unblock{false};
+    std::vector<FrameId> ids;
+    auto release = [&](ProcessedFrame&& f) {
+        if (f.id == 0) {
+            entered = true;
+            while (!unblock) std::this_thread::yield();
+        }
+        ids.push_back(f.id);
+    };
+
+    std::thread first([&] { buffer.insert(0, frame(0), release); });
+    while (!entered) std::this_thread::yield();
+
+    buffer.insert(1, frame(3), release);  // returns: nothing of its own is ready
+    buffer.skip(1, 5, release);
+    std::thread second([&] { buffer.insert(1, frame(1), release); });
+
+    unblock = true;
+    first.join();
+    second.join();
+    buffer.insert(0, frame(2), release);
+    CHECK((ids == std::vector<FrameId>{0, 1, 2, 3}));
+}
+
+void concurrent_producers_deliver_in_order() {
+    constexpr size_t PRODUCERS = 4;
+    constexpr FrameId COUNT = 20000;
+    ReorderBuffer buffer(PRODUCERS, COUNT);  // wide enough that nothing is forced out
+    std::vector<FrameId> ids;
+    auto release = [&](ProcessedFrame&& f) { ids.push_back(f.id); };
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&, p] {
+            for (FrameId id = p; id < COUNT; id += PRODUCERS) {
+                if (id % 7 == 3)
+                    buffer.skip(p, id, release);
+                else
+                    buffer.insert(p, frame(id), release);
+                if (id % 5 == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+
+    bool ordered = true;
+    size_t expected = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0 && ids[i] <= ids[i - 1]) ordered = false;
+        if (ids[i] % 7 == 3) ordered = false;
+    }
+    for (FrameId id = 0; id < COUNT; ++id)
+        if (id % 7 != 3) ++expected;
+    CHECK(ordered);
+    CHECK_EQ(ids.size(), expected);
+}
+
+}  
+
+int main() {
+    restores_order_across_producers();
+    skip_of_next_id_releases_it();
+    gaps_wait_for_every_producer();
+    window_forces_progress_and_late_frames_drop();
+    blocked_release_does_not_hold_the_buffer();
+    concurrent_producers_deliver_in_order();
+    return TEST_RESULT();
+}
@@ -0,0 +1,44 @@
+#include "asciinema/still.h"
+#include "check.h"
+
+#include <random>
+#include <vector>
+
+using asciinema::RowSadFn;
+
+namespace {
+
+// Every kernel must match the scalar one at every length and alignment,
+// so the vector loops and their tails agree.
+void kernels_match_scalar(RowSadFn kernel) {
+    std::mt19937 rng(5);
+    std::vector<uint8_t> a(400);
+    std::vector<uint8_t> b(400);
+    for (auto& v : a) v = static_cast<uint8_t>(rng());
+    for (auto& v : b) v = static_cast<uint8_t>(rng());
+    for (size_t offset = 0; offset < 32; offset += 3) {
+        for (size_t bytes = 0; bytes + offset + 1 <= b.size(); bytes += (bytes < 80 ? 1 : 13))
+            CHECK_EQ(kernel(a.data() + offset, b.data() + offset + 1, bytes),
+                     asciinema::row_sad_scalar(a.data() + offset, b.data() + offset + 1, bytes));
+    }
+}
+
+// Many 4K BGRA rows of full-scale differences must not wrap the accumulators.
+void long_rows_do_not_overflow(RowSadFn kernel) {
+    constexpr size_t BYTES = 3840 * 4 * 64;
+    std::vector<uint8_t> black(BYTES, 0);
+    std::vector<uint8_t> white(BYTES, 255);
+    CHECK_EQ(kernel(black.data(), white.data(), BYTES), uint64_t{255} * BYTES);
+    CHECK_EQ(kernel(white.data(), white.data(), BYTES), 0u);
+}
+
+}
+
+int main() {
+    for (RowSadFn kernel : asciinema::supported_sad_kernels()) {
+        kernels_match_scalar(kernel);
+        long_rows_do_not_overflow(kernel);
+    }
+    CHECK(asciinema::select_sad_kernel() == asciinema::supported_sad_kernels().front());
+    return TEST_RESULT();
+}